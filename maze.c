@@ -1,7 +1,23 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MAZE_X86_SIMD 1
+#endif
 
 // Step to the maze
 #define STEP_INTO_FROM_LEFT 1
@@ -14,10 +30,48 @@
 #define RIGHT_WALL 1
 #define UPPERorLOWER_WALL 2
 
+// --all-errors entry of a cell value outside 0-7, it ends the list like it ends the check
+#define BAD_VALUE 3
+
 // Solving rule
 #define RIGHT_HAND 0
 #define LEFT_HAND 1
 
+// Wall bits of a cell value
+#define WALL_L 1
+#define WALL_R 2
+#define WALL_V 4
+
+// Step taken when leaving through wall side w, shape 0 is ▼ (vertical neighbour above), 1 is ▲ (below)
+#define EXIT_SIDE(shape, w) ((w) == WALL_L ? STEP_INTO_FROM_RIGHT : (w) == WALL_R ? STEP_INTO_FROM_LEFT : \
+                             (shape) == 0 ? STEP_INTO_FROM_DOWN : STEP_INTO_FROM_UP)
+
+// Leave through the first open side out of a, b, c (in this order), 0 if the cell is closed
+#define FIRST_OPEN(shape, a, b, c, walls) \
+    (!((walls) & (a)) ? EXIT_SIDE(shape, a) : !((walls) & (b)) ? EXIT_SIDE(shape, b) : \
+     !((walls) & (c)) ? EXIT_SIDE(shape, c) : 0)
+
+#define RULE(shape, a, b, c) { \
+    FIRST_OPEN(shape, a, b, c, 0), FIRST_OPEN(shape, a, b, c, 1), FIRST_OPEN(shape, a, b, c, 2), \
+    FIRST_OPEN(shape, a, b, c, 3), FIRST_OPEN(shape, a, b, c, 4), FIRST_OPEN(shape, a, b, c, 5), \
+    FIRST_OPEN(shape, a, b, c, 6), FIRST_OPEN(shape, a, b, c, 7) }
+
+#define NO_RULE {0, 0, 0, 0, 0, 0, 0, 0}
+
+// Parallel parsing
+#define MAX_THREADS 64
+#define PARALLEL_MIN_BYTES (1 << 22)
+
+// Parallel BFS: levels smaller than this stay in the serial queue, bottom-up once the frontier is larger
+// than the unvisited cells divided by the ratio
+#define BFS_PARALLEL_FRONTIER 4096
+#define BFS_BOTTOM_UP_RATIO 14
+
+// Binary maze format (.tmz): 20 byte little-endian header followed by 3-bit wall codes
+#define TMZ_MAGIC "TMZ"
+#define TMZ_VERSION 1
+#define TMZ_HEADER_SIZE 20
+
 // Creating structure for maze
 typedef struct {
     int rows;
@@ -25,14 +79,262 @@ typedef struct {
     unsigned char *cells;
 } Map;
 
+// Next step for [shape][hand][step - 1][walls], shape 0 is ▼ and 1 is ▲, 0 means there is no way on
+// Each rule lists the sides in the order the hand tries them for the side we came in from
+static const unsigned char transitions[2][2][4][8] = {
+    // shape - ▼
+    {
+        // RIGHT_HAND: from left, from right, from up, (from down is not possible)
+        {RULE(0, WALL_R, WALL_V, WALL_L), RULE(0, WALL_V, WALL_L, WALL_R), RULE(0, WALL_L, WALL_R, WALL_V), NO_RULE},
+        // LEFT_HAND
+        {RULE(0, WALL_V, WALL_R, WALL_L), RULE(0, WALL_L, WALL_V, WALL_R), RULE(0, WALL_R, WALL_L, WALL_V), NO_RULE},
+    },
+    // shape - ▲
+    {
+        // RIGHT_HAND: from left, from right, (from up is not possible), from down
+        {RULE(1, WALL_V, WALL_R, WALL_L), RULE(1, WALL_L, WALL_V, WALL_R), NO_RULE, RULE(1, WALL_R, WALL_L, WALL_V)},
+        // LEFT_HAND
+        {RULE(1, WALL_R, WALL_V, WALL_L), RULE(1, WALL_V, WALL_L, WALL_R), NO_RULE, RULE(1, WALL_L, WALL_R, WALL_V)},
+    },
+};
+
+// Position change for every step, indexed by STEP_INTO_FROM_*
+static const int rowDelta[5] = {0, 0, 0, 1, -1};
+static const int colDelta[5] = {0, 1, -1, 0, 0};
+
+// How a wall-following walk ended
+#define WALK_RUNNING 0
+#define WALK_EXITED 1
+#define WALK_STUCK 2
+#define WALK_CYCLE 3
+#define WALK_PAUSED 4
+#define WALK_LIMIT 5
+
+// Steps between two looks at the clock when a deadline is set
+#define WALK_CHECK_STEPS (1ULL << 16)
+
+// Cycle detection: none, a bit per (cell, entry step), Brent's constant-memory detector, bitset if it fits
+#define CYCLES_OFF 0
+#define CYCLES_BITSET 1
+#define CYCLES_BRENT 2
+#define CYCLES_AUTO 3
+#define CYCLES_BITSET_LIMIT ((size_t) 1 << 28)
+
+// Largest jump index --where builds, in bytes
+#define JUMP_TABLE_LIMIT ((size_t) 1 << 30)
+
+// Exit codes of a walk that never leaves the maze and of a walk stopped by --max-steps or --deadline-ms
+#define EXIT_CYCLE 2
+#define EXIT_LIMIT 3
+
+// State of a wall-following walk, row/col is the last cell inside the maze and index its position in cells.
+// seen holds 4 bits per cell for the bitset detector, saved/power/lambda are Brent's checkpoint.
+// The walker returns WALK_PAUSED once steps reaches pause
+typedef struct {
+    int row;
+    int col;
+    size_t index;
+    int step;
+    unsigned long long steps;
+    unsigned long long pause;
+    int status;
+    int cycles;
+    uint64_t *seen;
+    size_t savedIndex;
+    int savedStep;
+    unsigned long long power;
+    unsigned long long lambda;
+} Walk;
+
+// Path output buffer, flushed to the file descriptor with write(2)
+#define WRITER_SIZE (1 << 20)
+
+// Path formats: "R,C" lines, start cell plus one letter per step, start cell plus 2 bits per step, no path at all
+#define FORMAT_CELLS 0
+#define FORMAT_MOVES 1
+#define FORMAT_BIN 2
+#define FORMAT_NONE 3
+
+// Binary path format: "TMP" + version, start row and column (u32), packed steps, step count (u64) at the end
+#define PATH_MAGIC "TMP"
+#define PATH_VERSION 1
+#define PATH_HEADER_SIZE 12
+#define PATH_TRAILER_SIZE 8
+
+typedef struct {
+    int fd;
+    int format;
+    size_t length;
+    bool failed;
+    char *buffer;
+    unsigned bits;
+    int pending;
+    unsigned long long moves;
+} PathWriter;
+
+// Read-only view of a whole input file (memory-mapped when possible)
+typedef struct {
+    const char *data;
+    size_t size;
+    bool mapped;
+} FileView;
+
+// Sequential reader handing out one row of the maze at a time, memory stays O(cols)
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t pos;
+    size_t end;
+    bool eof;
+    bool binary;
+    int rows;
+    int cols;
+    int row;
+    // Binary payload bookkeeping (offsets are relative to the payload start)
+    size_t base;
+    size_t hashed;
+    uint32_t hash;
+    uint32_t expected;
+} RowReader;
+
+// Alternative maze layout, the three walls are kept in separate bit-planes with 64 cells per word
+// and every row starting on a new word, bit j of a row is the wall of column j (0-based)
+typedef struct {
+    int rows;
+    int cols;
+    size_t stride;
+    uint64_t *left;
+    uint64_t *right;
+    uint64_t *vertical;
+} BitMap;
+
+// One inconsistent border, wall is RIGHT_WALL (with the cell to the right) or UPPERorLOWER_WALL (with the row above),
+// or BAD_VALUE for a cell that is not 0-7
+typedef struct {
+    int row;
+    int col;
+    int wall;
+} BorderError;
+
+// Growable list of border errors
+typedef struct {
+    BorderError *items;
+    size_t count;
+    size_t capacity;
+} ErrorList;
+
+// Part of the cells (whole bitset words [first, last)) owned by one thread of a parallel BFS. The cells of
+// the band in the current and the next level are listed in current/next starting at first * 64
+typedef struct BfsBand {
+    const Map *map;
+    const struct BfsBand *bands;
+    int id;
+    int count;
+    uint64_t *visited;
+    uint64_t *frontier;
+    unsigned char *parents;
+    uint32_t *current;
+    uint32_t *next;
+    size_t first;
+    size_t last;
+    size_t size;
+    size_t added;
+    bool bottomUp;
+    size_t found;
+} BfsBand;
+
+// Rows [first, last] of the maze labeled by one thread, parents are cell indices
+typedef struct {
+    const Map *map;
+    uint32_t *parents;
+    int first;
+    int last;
+} LabelBand;
+
+// One bucket of the A* open set, entries are cell index * 4 + step into the cell - 1
+typedef struct {
+    uint64_t *items;
+    size_t count;
+    size_t capacity;
+} Bucket;
+
+// Binary lifting over the walk states, cell index * 4 + step into the cell - 1. Level i of jumps holds the state
+// 2^i steps later, a state whose next step leaves the maze or is stuck maps to itself. cycles holds the length
+// of the cycle every state runs into, 1 for a walk that ends
+typedef struct {
+    size_t states;
+    int levels;
+    uint32_t *jumps;
+    uint32_t *cycles;
+} JumpIndex;
+
+// Rows [first, last) checked by one validator thread
+typedef struct {
+    const Map *map;
+    int first;
+    int last;
+    bool all;
+    ErrorList errors;
+    int result;
+} BorderBand;
+
+// Optional switches that may appear anywhere on the command line
+typedef struct {
+    bool allErrors;
+    int threads;
+    int format;
+    int cycles;
+    unsigned long long maxSteps;
+    long deadlineMs;
+    bool bidi;
+    bool length;
+    int hand;
+} Options;
+
+// One piece of the cell section decoded by a parser thread
+typedef struct {
+    const char *begin;
+    const char *end;
+    size_t first;
+    size_t count;
+    Map *map;
+    bool validate;
+    int result;
+} ParseChunk;
+
+// Number of worker threads, set from the number of online CPUs
+int threadCount = 1;
+
 // Printing help information
 int printHelp() {
     printf("Usage: ./maze [OPTIONS]\n");
     printf("Options:\n");
     printf(" --help                    Display this message\n");
     printf(" --test file.txt           Testing the validity of provided maze\n");
+    printf("   --all-errors            List every inconsistent border as R,C right|upper instead of stopping at the first,\n");
+    printf("                           a cell value outside 0-7 is listed as R,C value and ends the list\n");
+    printf("   --threads N             Load the whole maze and check it with N threads (default streams row by row)\n");
     printf(" --rpath R C file.txt      Solve the maze with right-hand rule starting from position R(row) C(column)\n");
     printf(" --lpath R C file.txt      Solve the maze with left-hand rule starting from position R(row) C(column)\n");
+    printf(" --convert in out          Convert the maze between text and binary (.tmz) format\n");
+    printf("   --format=cells|moves|bin  Path output: R,C lines (default), start and L/R/U/D per step, 2 bits per step\n");
+    printf("   --cycles=off|auto|bitset|brent  Detect walks that never leave the maze (default off)\n");
+    printf("   --max-steps N           Stop the walk after N steps\n");
+    printf("   --deadline-ms T         Stop the walk T milliseconds after the solve started\n");
+    printf("   --summary               Print only the exit cell, the step count and the walk time instead of the path\n");
+    printf("   --length                Print only how the walk ends and its step count, a walk in a circle exits with 2\n");
+    printf(" --shortest R C file.txt   Print the shortest path from R C to the nearest exit\n");
+    printf("   --bidi                  Search from the start and from all exits at once until they meet\n");
+    printf("   --threads N             Expand large BFS levels with N threads\n");
+    printf(" --astar R1 C1 R2 C2 file.txt  Print the shortest path between two cells (A* search)\n");
+    printf(" --reachable R C file.txt  Tell whether any exit can be reached from R C\n");
+    printf(" --escape file.txt         Label the open-space components, then answer R C lines from stdin\n");
+    printf(" --exit-table file.txt     Print the right- and left-hand exit of every border entrance\n");
+    printf(" --where R C K file.txt    Print where the walk from R C is after K steps, with its cycle if it has one\n");
+    printf(" --where file.txt          Build the jump index once, then answer R C K lines from stdin\n");
+    printf("   --hand=right|left       Rule of the --where walk (default right)\n");
+    printf(" --decode path             Expand a moves or bin path back to R,C lines\n");
     return 0;
 }
 
@@ -40,7 +342,7 @@ int printHelp() {
 int initMap(Map *map, int rows, int cols) {
     map->rows = rows;
     map->cols = cols;
-    map->cells = (unsigned char *) malloc(map->rows * map->cols * sizeof(unsigned char));
+    map->cells = (unsigned char *) malloc((size_t) map->rows * map->cols * sizeof(unsigned char));
     if (map->cells == NULL) {
         fprintf(stderr, "MALLOC_ERR\n");
         return 1;
@@ -48,37 +350,6 @@ int initMap(Map *map, int rows, int cols) {
     return 0;
 }
 
-// Store the data in map structure
-int readMap(Map *map, const char *fileName) {
-    // Open the file
-    FILE *file = fopen(fileName, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening file: %s\n", fileName);
-        return 1;
-    }
-
-    int rows;
-    int cols;
-
-    // Read the first line (definition of rows and columns)
-    fscanf(file, "%d %d", &rows, &cols);
-
-    initMap(map, rows, cols);
-
-    // Read values from the file and store them in the cells array
-    for (int i = 0; i < map->rows; i++) {
-        for (int j = 0; j < map->cols; j++) {
-            unsigned char value;
-            fscanf(file, "%hhu", &value);
-            map->cells[i * cols + j] = value;
-        }
-    }
-
-    // Close the file
-    fclose(file);
-    return 0;
-}
-
 // Destructor of map
 int freeMap (Map *map) {
     free(map->cells);
@@ -88,501 +359,3368 @@ int freeMap (Map *map) {
     return 0;
 }
 
-// Check that adjacent borders in the map declaration are the same
-int sharedBorder(const Map *map) {
-    for (int i = 0; i < map->rows; i++) {
-        for (int j = 0; j < map->cols; j++) {
-            unsigned char value = map->cells[(i * map->cols) + j];
-
-            if (j < (map->cols - 1)) {
-                // -1 because last column does not have column next to it
-                unsigned char nextBorder = map->cells[i * map->cols + (j + 1)];
-                if (((value >> 1) & 1) != ((nextBorder >> 0) & 1)) {
-                    return 0;
-                }
-            }
+// Read the whole file into memory, mmap for regular files and plain read() otherwise
+int openView(FileView *view, const char *fileName) {
+    view->data = NULL;
+    view->size = 0;
+    view->mapped = false;
 
-            // shape - ▼
-            if ((i % 2 == 0 && j % 2 == 0) || (i % 2 != 0 && j % 2 != 0)) {
-
-                if (i < map->rows && i > 0) {
-                    unsigned char upperBorder = map->cells[(i - 1) * map->cols + j];
-                    if (((value >> 2) & 1) != ((upperBorder >> 2) & 1)) {
-                        return 0;
-                    }
-                }
-            }
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening file: %s\n", fileName);
+        return 1;
+    }
 
-            // shape - ▲
-            else {
-                if (i < (map->rows - 1)) {
-                    // -1 because the last line does not have lower border
-                    unsigned char lowerBorder = map-> cells[(i+1) * map->cols + j];
-                    if (((value >> 2) & 1) != ((lowerBorder >> 2) & 1)) {
-                        return 0;
-                    }
-                }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        view->size = (size_t) info.st_size;
+        if (view->size == 0) {
+            close(fd);
+            return 0;
+        }
+        void *data = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            posix_madvise(data, view->size, POSIX_MADV_SEQUENTIAL);
+            view->data = data;
+            view->mapped = true;
+            close(fd);
+            return 0;
+        }
+        view->size = 0;
+    }
 
+    // Pipes and other special files can not be mapped, copy them instead
+    size_t capacity = 1 << 16;
+    char *buffer = malloc(capacity);
+    while (buffer != NULL) {
+        if (view->size == capacity) {
+            char *bigger = realloc(buffer, capacity * 2);
+            if (bigger == NULL) {
+                free(buffer);
+                buffer = NULL;
+                break;
             }
+            buffer = bigger;
+            capacity *= 2;
         }
+        ssize_t got = read(fd, buffer + view->size, capacity - view->size);
+        if (got <= 0) {
+            break;
+        }
+        view->size += (size_t) got;
+    }
+    close(fd);
+    if (buffer == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 1;
     }
-    return 1;
+    view->data = buffer;
+    return 0;
 }
 
-// Function that is testing the declaration of map, returns 1 if INVALID and 0 if VALID
-int testMap(const char *fileName) {
-    FILE *file = fopen(fileName, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening file: %s\n", fileName);
-        return 1;
+// Release the file view
+int closeView(FileView *view) {
+    if (view->mapped) {
+        munmap((void *) view->data, view->size);
+    } else {
+        free((void *) view->data);
     }
+    view->data = NULL;
+    view->size = 0;
+    view->mapped = false;
+    return 0;
+}
 
-    // Read the first line (definition of rows and columns)
-    int rows, cols;
-    if (fscanf(file, "%d %d", &rows, &cols) != 2) {
-        fclose(file);
-        return 1;
+// Whitespace as accepted by scanf
+static inline bool isBlank(char ch) {
+    return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+// Read a signed decimal number (like "%d"), returns false when there is none
+bool scanInt(const char **pos, const char *end, int *value) {
+    const char *p = *pos;
+    while (p < end && isBlank(*p)) {
+        p++;
     }
-    if (rows <= 0 || cols <= 0) {
-        fclose(file);
-        return 1;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
     }
 
-    Map map;
-    initMap(&map, rows, cols);
+    long long number = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        number = number * 10 + (*p - '0');
+        if (number > INT_MAX) {
+            return false;
+        }
+        p++;
+    }
+    *value = negative ? (int) -number : (int) number;
+    *pos = p;
+    return true;
+}
 
-    // Read other values
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            unsigned char value;
-            value = fgetc(file);
+// Decode count cell values straight into cells, returns 1 if the input ends early or is not a number and 2 if
+// a value is outside 0-7, that cell is stored as 0xFF so it cannot pass for a valid one
+int scanCells(const char **pos, const char *end, unsigned char *cells, size_t count) {
+    int result = 0;
+    const char *p = *pos;
+    for (size_t k = 0; k < count; k++) {
+        while (p < end && isBlank(*p)) {
+            p++;
+        }
+        if (p == end || *p < '0' || *p > '9') {
+            *pos = p;
+            return 1;
+        }
 
-            if (value > '7') {
-                fclose(file);
-                freeMap(&map);
-                return 1;
+        // Once the value is past 7 the remaining digits cannot bring it back, so it stops growing there
+        unsigned int value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (value <= 7) {
+                value = value * 10 + (unsigned int) (*p - '0');
             }
-            map.cells[i * cols + j] = value;
+            p++;
         }
-        int c;
-        while ((c = fgetc(file)) != '\n' && c != EOF) {
-            // Do nothing, just go to the end of the row
+        if (value > 7) {
+            cells[k] = 0xFF;
+            result = 2;
+        } else {
+            cells[k] = (unsigned char) value;
         }
     }
-    freeMap(&map);
+    *pos = p;
+    return result;
+}
 
-    Map maze;
-    readMap(&maze, fileName);
+// Vectorized decoding of canonically formatted cells ("d d d ..."), every 16-bit lane holds
+// a digit followed by a space, so lane - "0 " has to fall into 0..7 for the lane to be accepted.
+// Each kernel returns how many leading cells it decoded, the rest is left to the scalar scanner.
+static size_t decodeRunScalar(const char *p, const char *end, unsigned char *cells, size_t count) {
+    size_t n = 0;
+    while (n < count && p + 2 <= end && p[0] >= '0' && p[0] <= '7' && p[1] == ' ') {
+        cells[n++] = (unsigned char) (p[0] - '0');
+        p += 2;
+    }
+    return n;
+}
 
-    // Check the borders between cells
-    if (!sharedBorder(&maze)) {
-        fclose(file);
-        freeMap(&maze);
-        return 1;
+#ifdef MAZE_X86_SIMD
+static size_t decodeRunSSE2(const char *p, const char *end, unsigned char *cells, size_t count) {
+    const __m128i base = _mm_set1_epi16(0x2030);
+    const __m128i high = _mm_set1_epi16((short) 0xFFF8);
+    size_t n = 0;
+    while (n < count && end - p >= 16) {
+        __m128i lanes = _mm_sub_epi16(_mm_loadu_si128((const __m128i *) p), base);
+        __m128i good = _mm_cmpeq_epi16(_mm_and_si128(lanes, high), _mm_setzero_si128());
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(good);
+        size_t accepted = (size_t) __builtin_ctz(~mask | 0x10000u) / 2;
+        if (accepted > count - n) {
+            accepted = count - n;
+        }
+        unsigned char values[16];
+        _mm_storeu_si128((__m128i *) values, _mm_packus_epi16(lanes, lanes));
+        memcpy(cells + n, values, accepted);
+        n += accepted;
+        p += 2 * accepted;
+        if (accepted < 8) {
+            break;
+        }
     }
+    return n;
+}
 
-    fclose(file);
-    freeMap(&maze);
+__attribute__((target("avx2")))
+static size_t decodeRunAVX2(const char *p, const char *end, unsigned char *cells, size_t count) {
+    const __m256i base = _mm256_set1_epi16(0x2030);
+    const __m256i high = _mm256_set1_epi16((short) 0xFFF8);
+    size_t n = 0;
+    while (n < count && end - p >= 32) {
+        __m256i lanes = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *) p), base);
+        __m256i good = _mm256_cmpeq_epi16(_mm256_and_si256(lanes, high), _mm256_setzero_si256());
+        uint64_t mask = (uint32_t) _mm256_movemask_epi8(good);
+        size_t accepted = (size_t) __builtin_ctzll(~mask) / 2;
+        if (accepted > count - n) {
+            accepted = count - n;
+        }
+        // packus works per 128-bit half, put both halves of cells next to each other
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lanes, lanes), 0xD8);
+        unsigned char values[32];
+        _mm256_storeu_si256((__m256i *) values, packed);
+        memcpy(cells + n, values, accepted);
+        n += accepted;
+        p += 2 * accepted;
+        if (accepted < 16) {
+            break;
+        }
+    }
+    return n;
+}
 
-    return 0;
+__attribute__((target("avx512f,avx512bw")))
+static size_t decodeRunAVX512(const char *p, const char *end, unsigned char *cells, size_t count) {
+    const __m512i base = _mm512_set1_epi16(0x2030);
+    const __m512i high = _mm512_set1_epi16((short) 0xFFF8);
+    size_t n = 0;
+    while (n < count && end - p >= 64) {
+        __m512i lanes = _mm512_sub_epi16(_mm512_loadu_si512((const void *) p), base);
+        uint64_t bad = (uint32_t) _mm512_test_epi16_mask(lanes, high);
+        size_t accepted = (size_t) __builtin_ctzll(bad | (1ull << 32));
+        if (accepted > count - n) {
+            accepted = count - n;
+        }
+        unsigned char values[32];
+        _mm256_storeu_si256((__m256i *) values, _mm512_cvtepi16_epi8(lanes));
+        memcpy(cells + n, values, accepted);
+        n += accepted;
+        p += 2 * accepted;
+        if (accepted < 32) {
+            break;
+        }
+    }
+    return n;
 }
+#endif
 
-// Check if there is a way how to enter maze
-bool entryPossible (Map *map, int r, int c) {
-    if (r == 1 || r == map->rows || c == 1 || c == map->cols) {
-        if ((r == 1 && c == 1) || (r == map->rows && c == 1)) {
-            if (((((map->cells[((r - 1) * map->cols) + c]) >> 0) & 1) == 1) &&
-                ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1)) {
-                printf("Not possible to enter maze");
-                return false;
-            }
+// Kernel picked for this CPU by initKernels()
+static size_t (*decodeRun)(const char *p, const char *end, unsigned char *cells, size_t count) = decodeRunScalar;
+
+// Decode count cells, returns 0 if all of them are 0-7, 2 if some value is bigger and 1 if the input is malformed
+int decodeCells(const char **pos, const char *end, unsigned char *cells, size_t count) {
+    const char *p = *pos;
+    int result = 0;
+    size_t k = 0;
+    while (k < count) {
+        while (p < end && isBlank(*p)) {
+            p++;
+        }
+        size_t n = decodeRun(p, end, cells + k, count - k);
+        k += n;
+        p += 2 * n;
+        if (k == count) {
+            break;
         }
 
-        if ((r == 1 && c == map->cols) || (r == map->rows && c == map->cols)) {
-            if (((((map->cells[((r - 1) * map->cols) + c]) >> 1) & 1) == 1) &&
-                ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1)) {
-                printf("Not possible to enter maze");
-                return false;
-            }
+        // Whatever the kernel did not accept (line ends, long numbers, garbage) goes through the scalar scanner
+        int scanned = scanCells(&p, end, cells + k, 1);
+        if (scanned == 1) {
+            *pos = p;
+            return 1;
+        }
+        result |= scanned;
+        k++;
+    }
+    *pos = p;
+    return result;
+}
 
-            if (c == 1) {
-                if ((((map->cells[((r - 1) * map->cols) + c]) >> 0) & 1) == 1) {
-                    printf("Not possible to enter maze");
-                    return false;
-                }
-            }
-            if (c == map->cols) {
-                if ((((map->cells[((r - 1) * map->cols) + c]) >> 1) & 1) == 1) {
-                    printf("Not possible to enter maze");
-                    return false;
-                }
-            }
+// Check borders of one row against its right neighbours and the row above, returns the first bad column or -1
+int rowBorder(const unsigned char *upper, const unsigned char *row, int i, int cols) {
+    for (int j = 0; j < cols; j++) {
+        unsigned char value = row[j];
 
-            if (r == 1) {
-                if ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1) {
-                    printf("Not possible to enter maze");
-                    return false;
-                }
+        if (j < (cols - 1)) {
+            // -1 because last column does not have column next to it
+            unsigned char nextBorder = row[j + 1];
+            if (((value >> 1) & 1) != ((nextBorder >> 0) & 1)) {
+                return j;
             }
-            if (r == map->rows) {
-                if ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1) {
-                    printf("Not possible to enter maze");
-                    return false;
-                }
-            } else {
-                printf("Not possible to enter maze");
-                return false;
+        }
+
+        // shape - ▼ shares its upper border with the ▲ above it
+        if (upper != NULL && (i + j) % 2 == 0) {
+            if (((value >> 2) & 1) != ((upper[j] >> 2) & 1)) {
+                return j;
             }
         }
     }
-    return true;
+    return -1;
 }
 
-// Check borders of cell
-bool isborder(Map *map, int r, int c, int border) {
-    unsigned char value = map->cells[(((r - 1) * map->cols) + (c-1))];
-    if (border == LEFT_WALL) {
-        if (((value >> 0) & 1) == 1) {
-            return true;
-        }
-    } else if (border == RIGHT_WALL) {
-        if (((value>> 1) & 1) == 1) {
-            return true;
+// Split one row of cells into the three wall bit-planes
+void packRow(const unsigned char *row, int cols, uint64_t *left, uint64_t *right, uint64_t *vertical) {
+    int j = 0;
+    for (size_t w = 0; j < cols; w++) {
+        uint64_t l = 0;
+        uint64_t r = 0;
+        uint64_t v = 0;
+        int bit = 0;
+#ifdef MAZE_X86_SIMD
+        // Shift the wall bit into the sign of each byte and collect 16 of them with movemask
+        for (; bit + 16 <= 64 && j + 16 <= cols; bit += 16, j += 16) {
+            __m128i cells = _mm_loadu_si128((const __m128i *) (row + j));
+            l |= (uint64_t) (unsigned int) _mm_movemask_epi8(_mm_slli_epi16(cells, 7)) << bit;
+            r |= (uint64_t) (unsigned int) _mm_movemask_epi8(_mm_slli_epi16(cells, 6)) << bit;
+            v |= (uint64_t) (unsigned int) _mm_movemask_epi8(_mm_slli_epi16(cells, 5)) << bit;
         }
-    } else {
-        if (((value >> 2) & 1) == 1) {
-            return true;
+#endif
+        for (; bit < 64 && j < cols; bit++, j++) {
+            l |= (uint64_t) (row[j] & 1) << bit;
+            r |= (uint64_t) ((row[j] >> 1) & 1) << bit;
+            v |= (uint64_t) ((row[j] >> 2) & 1) << bit;
         }
+        left[w] = l;
+        right[w] = r;
+        vertical[w] = v;
     }
-    return false;
 }
 
-// Control of the side from which we enter the cell and the cells borders
-int start_border(Map *map, int r, int c, int leftright) {
-    bool borderL = isborder(map, r, c, 0);
-    bool borderR = isborder(map, r, c, 1);
-    bool borderUL = isborder(map, r, c, 2);
+// Columns of row i whose ▼ cell shares its upper border with the row above
+static inline uint64_t downMask(int i) {
+    return (i % 2 == 0) ? 0x5555555555555555ull : 0xAAAAAAAAAAAAAAAAull;
+}
 
-    if ((leftright == RIGHT_HAND) || (leftright == LEFT_HAND)) {
-        if (c == 1) {
-            if (borderL == false) {
-                return STEP_INTO_FROM_LEFT;
-            }
+// Bits of word w that belong to columns below limit
+static inline uint64_t columnMask(size_t w, long limit) {
+    long first = (long) w * 64;
+    if (limit - first >= 64) {
+        return ~0ull;
+    }
+    return (limit <= first) ? 0 : ((uint64_t) 1 << (limit - first)) - 1;
+}
+
+// Mismatch masks of word w of a row: right wall of j has to match left wall of j+1 (R ^ (L >> 1)) and every
+// ▼ cell has to match the vertical wall of the row above
+static inline void borderMasks(const uint64_t *upper, const uint64_t *left, const uint64_t *right,
+                               const uint64_t *vertical, int i, int cols, size_t w, uint64_t *horizontal,
+                               uint64_t *vert) {
+    size_t stride = ((size_t) cols + 63) / 64;
+    uint64_t nextLeft = (left[w] >> 1) | ((w + 1 < stride) ? left[w + 1] << 63 : 0);
+    *horizontal = (right[w] ^ nextLeft) & columnMask(w, (long) cols - 1);
+    *vert = (upper == NULL) ? 0 : (vertical[w] ^ upper[w]) & downMask(i) & columnMask(w, cols);
+}
+
+// Word kernel for one row, returns the first bad column or -1
+static int rowBorderBitsScalar(const uint64_t *upper, const uint64_t *left, const uint64_t *right,
+                               const uint64_t *vertical, int i, int cols) {
+    size_t stride = ((size_t) cols + 63) / 64;
+    for (size_t w = 0; w < stride; w++) {
+        uint64_t horizontal;
+        uint64_t vert;
+        borderMasks(upper, left, right, vertical, i, cols, w, &horizontal, &vert);
+        uint64_t bad = horizontal | vert;
+        if (bad != 0) {
+            return (int) (w * 64 + (size_t) __builtin_ctzll(bad));
         }
-        if (c == map->cols) {
-            if (borderR == false) {
-                return STEP_INTO_FROM_RIGHT;
-            }
+    }
+    return -1;
+}
+
+#ifdef MAZE_X86_SIMD
+// Same kernel on four words at a time, the last word of the row (partial masks) is left to the scalar one
+__attribute__((target("avx2")))
+static int rowBorderBitsAVX2(const uint64_t *upper, const uint64_t *left, const uint64_t *right,
+                             const uint64_t *vertical, int i, int cols) {
+    size_t stride = ((size_t) cols + 63) / 64;
+    const __m256i down = _mm256_set1_epi64x((long long) downMask(i));
+    size_t w = 0;
+    for (; w + 4 < stride; w += 4) {
+        __m256i nextLeft = _mm256_or_si256(_mm256_srli_epi64(_mm256_loadu_si256((const __m256i *) (left + w)), 1),
+                                           _mm256_slli_epi64(_mm256_loadu_si256((const __m256i *) (left + w + 1)), 63));
+        __m256i bad = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (right + w)), nextLeft);
+        if (upper != NULL) {
+            __m256i vertBad = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (vertical + w)),
+                                               _mm256_loadu_si256((const __m256i *) (upper + w)));
+            bad = _mm256_or_si256(bad, _mm256_and_si256(vertBad, down));
         }
-        if (r == 1) {
-            if (borderUL == false) {
-                return STEP_INTO_FROM_UP;
-            }
+        if (!_mm256_testz_si256(bad, bad)) {
+            break;
         }
-        if (r == map->rows) {
-            if (borderUL == false) {
-                return STEP_INTO_FROM_DOWN;
-            }
+    }
+    if (w == 0) {
+        return rowBorderBitsScalar(upper, left, right, vertical, i, cols);
+    }
+
+    // Finish (or locate the mismatch) on the remaining words, w is a multiple of 64 columns
+    int offset = (int) (w * 64);
+    int found = rowBorderBitsScalar(upper != NULL ? upper + w : NULL, left + w, right + w, vertical + w,
+                                    i, cols - offset);
+    return (found < 0) ? -1 : offset + found;
+}
+#endif
+
+// Row border kernel picked for this CPU by initKernels()
+static int (*rowBorderBits)(const uint64_t *upper, const uint64_t *left, const uint64_t *right,
+                            const uint64_t *vertical, int i, int cols) = rowBorderBitsScalar;
+
+// First column of the row holding a value outside 0-7, -1 if there is none
+static inline int badValue(const unsigned char *row, int cols) {
+    for (int j = 0; j < cols; j++) {
+        if (row[j] > 7) {
+            return j;
         }
     }
     return -1;
 }
 
-// Evaluation of which cell we enter as the next one
-int move(Map *map, int* r, int* c, int leftright, bool borderL, bool borderR, bool borderUL, bool *firstStep, int *step) {
-    if (*firstStep == true) {
-        *step = start_border(map, *r, *c, leftright);
-        *firstStep = false;
+// Append one error to the list, returns 1 when out of memory
+int addError(ErrorList *list, int row, int col, int wall) {
+    if (list->count == list->capacity) {
+        size_t capacity = (list->capacity == 0) ? 64 : list->capacity * 2;
+        BorderError *bigger = realloc(list->items, capacity * sizeof(BorderError));
+        if (bigger == NULL) {
+            fprintf(stderr, "MALLOC_ERR\n");
+            return 1;
+        }
+        list->items = bigger;
+        list->capacity = capacity;
     }
+    list->items[list->count].row = row;
+    list->items[list->count].col = col;
+    list->items[list->count].wall = wall;
+    list->count++;
+    return 0;
+}
 
-    // shape - ▼
-    if (( *r % 2 != 0 && *c % 2 != 0) || (*r % 2 == 0 && *c % 2 == 0)) {
-        if (leftright == RIGHT_HAND) {
-            if (*step == STEP_INTO_FROM_LEFT) {
-                if (borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if (borderR == true && borderUL == false) {
-                    *r -= 1;
-                    *step = STEP_INTO_FROM_DOWN;
-                }
-                if ((borderR == true && borderUL == true && borderL == false)) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-            } else if (*step == STEP_INTO_FROM_RIGHT) {
-                if (borderUL == false) {
-                    *r -= 1;
-                    *step = STEP_INTO_FROM_DOWN;
-                }
-                if (borderUL == true && borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderUL == true && borderL == true && borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
+// Release the error list
+int freeErrors(ErrorList *list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    return 0;
+}
+
+// Append every bad border of row i (1-based positions) in column order, with all == false only the first one
+// Returns the number of errors found in the row, -1 when out of memory
+int rowBorderErrors(const uint64_t *upper, const uint64_t *left, const uint64_t *right, const uint64_t *vertical,
+                    int i, int cols, bool all, ErrorList *errors) {
+    if (!all) {
+        int j = rowBorderBits(upper, left, right, vertical, i, cols);
+        if (j < 0) {
+            return 0;
+        }
+        uint64_t horizontal;
+        uint64_t vert;
+        borderMasks(upper, left, right, vertical, i, cols, (size_t) j / 64, &horizontal, &vert);
+        int wall = ((horizontal >> (j % 64)) & 1) ? RIGHT_WALL : UPPERorLOWER_WALL;
+        return addError(errors, i + 1, j + 1, wall) ? -1 : 1;
+    }
+
+    int found = 0;
+    size_t stride = ((size_t) cols + 63) / 64;
+    for (size_t w = 0; w < stride; w++) {
+        uint64_t horizontal;
+        uint64_t vert;
+        borderMasks(upper, left, right, vertical, i, cols, w, &horizontal, &vert);
+        for (uint64_t bad = horizontal | vert; bad != 0; bad &= bad - 1) {
+            int bit = __builtin_ctzll(bad);
+            int col = (int) (w * 64) + bit + 1;
+            if (((horizontal >> bit) & 1) && addError(errors, i + 1, col, RIGHT_WALL)) {
+                return -1;
+            }
+            if (((vert >> bit) & 1) && addError(errors, i + 1, col, UPPERorLOWER_WALL)) {
+                return -1;
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+// Check that adjacent borders in the map declaration are the same
+int sharedBorder(const Map *map) {
+    size_t stride = ((size_t) map->cols + 63) / 64;
+    uint64_t *words = malloc(4 * stride * sizeof(uint64_t));
+    if (words == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 0;
+    }
+    uint64_t *upper = words;
+    uint64_t *vertical = words + stride;
+    uint64_t *left = words + 2 * stride;
+    uint64_t *right = words + 3 * stride;
+
+    int result = 1;
+    for (int i = 0; i < map->rows && result; i++) {
+        packRow(map->cells + (size_t) i * map->cols, map->cols, left, right, vertical);
+        if (rowBorderBits(i > 0 ? upper : NULL, left, right, vertical, i, map->cols) >= 0) {
+            result = 0;
+        }
+        uint64_t *swap = upper;
+        upper = vertical;
+        vertical = swap;
+    }
+    free(words);
+    return result;
+}
+
+// Choose the widest kernels the CPU supports
+void initKernels() {
+#ifdef MAZE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        rowBorderBits = rowBorderBitsAVX2;
+    }
+    if (__builtin_cpu_supports("avx512bw")) {
+        decodeRun = decodeRunAVX512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        decodeRun = decodeRunAVX2;
+    } else {
+        decodeRun = decodeRunSSE2;
+    }
+#endif
+}
+
+// Little-endian helpers for the binary header
+static inline uint32_t getU32(const unsigned char *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void putU32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char) value;
+    p[1] = (unsigned char) (value >> 8);
+    p[2] = (unsigned char) (value >> 16);
+    p[3] = (unsigned char) (value >> 24);
+}
+
+// FNV-1a checksum of the packed cells
+uint32_t checksum(const unsigned char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t k = 0; k < size; k++) {
+        hash = (hash ^ data[k]) * 16777619u;
+    }
+    return hash;
+}
+
+// Number of bytes taken by count packed 3-bit cells
+static inline size_t packedSize(size_t count) {
+    return (count * 3 + 7) / 8;
+}
+
+// Pack cells into 3-bit codes, cell k occupies bits 3k..3k+2 of the output
+void packCells(const unsigned char *cells, size_t count, unsigned char *out) {
+    size_t k = 0;
+    // 8 cells fill exactly 3 bytes
+    for (; k + 8 <= count; k += 8) {
+        uint32_t word = 0;
+        for (int b = 0; b < 8; b++) {
+            word |= (uint32_t) (cells[k + b] & 7) << (3 * b);
+        }
+        *out++ = (unsigned char) word;
+        *out++ = (unsigned char) (word >> 8);
+        *out++ = (unsigned char) (word >> 16);
+    }
+    uint32_t word = 0;
+    for (size_t b = 0; k + b < count; b++) {
+        word |= (uint32_t) (cells[k + b] & 7) << (3 * b);
+    }
+    for (size_t b = 0; b < packedSize(count - k); b++) {
+        *out++ = (unsigned char) (word >> (8 * b));
+    }
+}
+
+// Expand 3-bit codes back to one cell per byte
+void unpackCells(const unsigned char *in, size_t count, unsigned char *cells) {
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        uint32_t word = (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16);
+        in += 3;
+        for (int b = 0; b < 8; b++) {
+            cells[k + b] = (unsigned char) ((word >> (3 * b)) & 7);
+        }
+    }
+    uint32_t word = 0;
+    for (size_t b = 0; b < packedSize(count - k); b++) {
+        word |= (uint32_t) in[b] << (8 * b);
+    }
+    for (size_t b = 0; k + b < count; b++) {
+        cells[k + b] = (unsigned char) ((word >> (3 * b)) & 7);
+    }
+}
+
+// Check whether the file view holds a binary maze
+static inline bool isBinary(const FileView *view) {
+    return view->size >= TMZ_HEADER_SIZE && memcmp(view->data, TMZ_MAGIC, 4) == 0;
+}
+
+// Check the stored checksum of a binary maze against its packed cells, a text maze has none and passes
+bool checksumMatches(const FileView *view) {
+    if (!isBinary(view)) {
+        return true;
+    }
+    const unsigned char *header = (const unsigned char *) view->data;
+    size_t size = packedSize((size_t) getU32(header + 8) * getU32(header + 12));
+    return view->size - TMZ_HEADER_SIZE >= size && checksum(header + TMZ_HEADER_SIZE, size) == getU32(header + 16);
+}
+
+// Load a binary maze straight from the mapped file, with validate the checksum and borders are checked too
+int parseBinary(Map *map, const FileView *view, bool validate) {
+    const unsigned char *header = (const unsigned char *) view->data;
+    uint32_t version = getU32(header + 4);
+    uint32_t rows = getU32(header + 8);
+    uint32_t cols = getU32(header + 12);
+    if (version != TMZ_VERSION || rows == 0 || cols == 0 || rows > INT_MAX || cols > INT_MAX) {
+        return 1;
+    }
+
+    size_t count = (size_t) rows * cols;
+    const unsigned char *payload = header + TMZ_HEADER_SIZE;
+    if (view->size - TMZ_HEADER_SIZE < packedSize(count)) {
+        return 1;
+    }
+    if (validate && !checksumMatches(view)) {
+        return 1;
+    }
+
+    if (initMap(map, (int) rows, (int) cols)) {
+        return 1;
+    }
+    unpackCells(payload, count, map->cells);
+
+    if (validate && !sharedBorder(map)) {
+        freeMap(map);
+        return 1;
+    }
+    return 0;
+}
+
+// Count whitespace separated tokens between begin and end
+size_t countTokens(const char *begin, const char *end) {
+    size_t count = 0;
+    bool inToken = false;
+    const char *p = begin;
+#ifdef MAZE_X86_SIMD
+    // A token starts at every non-blank byte that follows a blank one
+    unsigned int previous = 1;
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t' - 1);
+    const __m128i cr = _mm_set1_epi8('\r' + 1);
+    for (; end - p >= 16; p += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) p);
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(bytes, space),
+                                     _mm_and_si128(_mm_cmpgt_epi8(bytes, tab), _mm_cmplt_epi8(bytes, cr)));
+        unsigned int blanks = (unsigned int) _mm_movemask_epi8(blank);
+        unsigned int starts = ~blanks & ((blanks << 1) | previous) & 0xFFFF;
+        count += (size_t) __builtin_popcount(starts);
+        previous = blanks >> 15;
+    }
+    inToken = (p > begin) && !isBlank(p[-1]);
+#endif
+    for (; p < end; p++) {
+        if (isBlank(*p)) {
+            inToken = false;
+        } else if (!inToken) {
+            inToken = true;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Check rows that lie completely in the given range of cells, each row together with the one above it
+static int checkRows(const Map *map, size_t first, size_t last) {
+    size_t cols = (size_t) map->cols;
+    size_t i = (first == 0) ? 0 : (first + cols - 1) / cols + 1;
+    for (; (i + 1) * cols <= last && i < (size_t) map->rows; i++) {
+        const unsigned char *row = map->cells + i * cols;
+        if (rowBorder(i > 0 ? row - cols : NULL, row, (int) i, map->cols) >= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// First pass of the parser threads
+static void *countChunk(void *arg) {
+    ParseChunk *chunk = arg;
+    chunk->count = countTokens(chunk->begin, chunk->end);
+    return NULL;
+}
+
+// Second pass of the parser threads, decode the chunk into its place in the cells array
+static void *decodeChunk(void *arg) {
+    ParseChunk *chunk = arg;
+    size_t total = (size_t) chunk->map->rows * chunk->map->cols;
+    chunk->result = 0;
+    if (chunk->first >= total) {
+        return NULL;
+    }
+
+    size_t count = chunk->count;
+    if (count > total - chunk->first) {
+        count = total - chunk->first;
+    }
+    const char *pos = chunk->begin;
+    chunk->result = decodeCells(&pos, chunk->end, chunk->map->cells + chunk->first, count);
+    if (chunk->result == 0 && chunk->validate) {
+        chunk->result = checkRows(chunk->map, chunk->first, chunk->first + count);
+    }
+    return NULL;
+}
+
+// Run the worker on count work items of the given size, each in its own thread
+void runWorkers(void *work, size_t size, int count, void *(*worker)(void *)) {
+    pthread_t threads[MAX_THREADS];
+    bool started[MAX_THREADS];
+    for (int t = 0; t < count; t++) {
+        void *item = (char *) work + (size_t) t * size;
+        started[t] = pthread_create(&threads[t], NULL, worker, item) == 0;
+        if (!started[t]) {
+            worker(item);
+        }
+    }
+    for (int t = 0; t < count; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+}
+
+// Decode the cell section with several threads, chunks are split at line ends
+int parseChunks(Map *map, const char *pos, const char *end, bool validate) {
+    ParseChunk chunks[MAX_THREADS];
+    int count = threadCount;
+    size_t length = (size_t) (end - pos);
+    const char *begin = pos;
+    for (int t = 0; t < count; t++) {
+        const char *stop = (t == count - 1) ? end : pos + length * (t + 1) / count;
+        if (stop < begin) {
+            stop = begin;
+        }
+        const char *newline = memchr(stop, '\n', (size_t) (end - stop));
+        stop = (newline == NULL || t == count - 1) ? end : newline + 1;
+
+        chunks[t].begin = begin;
+        chunks[t].end = stop;
+        chunks[t].map = map;
+        chunks[t].validate = validate;
+        begin = stop;
+    }
+
+    runWorkers(chunks, sizeof(ParseChunk), count, countChunk);
+    size_t first = 0;
+    for (int t = 0; t < count; t++) {
+        chunks[t].first = first;
+        first += chunks[t].count;
+    }
+    if (first < (size_t) map->rows * map->cols) {
+        return 1;
+    }
+    runWorkers(chunks, sizeof(ParseChunk), count, decodeChunk);
+
+    for (int t = 0; t < count; t++) {
+        if (chunks[t].result == 1 || (validate && chunks[t].result != 0)) {
+            return 1;
+        }
+    }
+    if (!validate) {
+        return 0;
+    }
+
+    // Rows crossing a chunk edge could only be checked after all chunks are decoded
+    size_t cols = (size_t) map->cols;
+    for (int t = 1; t < count; t++) {
+        size_t edge = chunks[t].first;
+        if (edge >= (size_t) map->rows * cols) {
+            break;
+        }
+        for (size_t i = edge / cols; i <= (edge + cols - 1) / cols + 1 && i < (size_t) map->rows; i++) {
+            const unsigned char *row = map->cells + i * cols;
+            if (rowBorder(i > 0 ? row - cols : NULL, row, (int) i, map->cols) >= 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Parse the cells of the file view, with validate each row is checked for values and borders as soon as it is read
+int parseMap(Map *map, const FileView *view, bool validate) {
+    if (isBinary(view)) {
+        return parseBinary(map, view, validate);
+    }
+
+    const char *pos = view->data;
+    const char *end = view->data + view->size;
+
+    // Read the first line (definition of rows and columns)
+    int rows;
+    int cols;
+    if (!scanInt(&pos, end, &rows) || !scanInt(&pos, end, &cols) || rows <= 0 || cols <= 0) {
+        return 1;
+    }
+
+    if (initMap(map, rows, cols)) {
+        return 1;
+    }
+
+    // Big files are split between threads
+    if (threadCount > 1 && end - pos >= PARALLEL_MIN_BYTES) {
+        if (parseChunks(map, pos, end, validate)) {
+            freeMap(map);
+            return 1;
+        }
+        return 0;
+    }
+
+    // Decode values from the file straight into the cells array
+    for (int i = 0; i < rows; i++) {
+        unsigned char *row = map->cells + (size_t) i * cols;
+        int decoded = decodeCells(&pos, end, row, (size_t) cols);
+        if (decoded == 1) {
+            freeMap(map);
+            return 1;
+        }
+        if (!validate) {
+            continue;
+        }
+
+        const unsigned char *upper = (i > 0) ? row - cols : NULL;
+        if (decoded != 0 || rowBorder(upper, row, i, cols) >= 0) {
+            freeMap(map);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Read and validate the map in a single pass, returns 1 if INVALID and 0 if VALID
+int loadMap(Map *map, const char *fileName) {
+    FileView view;
+    if (openView(&view, fileName)) {
+        return 1;
+    }
+    int result = parseMap(map, &view, true);
+    closeView(&view);
+    return result;
+}
+
+// Move unread data to the front of the buffer and read more, returns false when nothing more could be read
+bool fillRows(RowReader *reader) {
+    if (reader->eof) {
+        return false;
+    }
+
+    // Bytes of the binary payload leave the buffer here, so include them in the checksum first
+    if (reader->binary) {
+        size_t from = reader->hashed - reader->base;
+        for (size_t k = from; k < reader->pos; k++) {
+            reader->hash = (reader->hash ^ (unsigned char) reader->buffer[k]) * 16777619u;
+        }
+        reader->hashed = reader->base + reader->pos;
+        reader->base += reader->pos;
+    }
+    memmove(reader->buffer, reader->buffer + reader->pos, reader->end - reader->pos);
+    reader->end -= reader->pos;
+    reader->pos = 0;
+
+    // A single row does not fit, make room for it
+    if (reader->end == reader->capacity) {
+        char *bigger = realloc(reader->buffer, reader->capacity * 2);
+        if (bigger == NULL) {
+            fprintf(stderr, "MALLOC_ERR\n");
+            reader->eof = true;
+            return false;
+        }
+        reader->buffer = bigger;
+        reader->capacity *= 2;
+    }
+
+    ssize_t got = read(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end);
+    if (got <= 0) {
+        reader->eof = true;
+        return false;
+    }
+    reader->end += (size_t) got;
+    return true;
+}
+
+// Open the maze for row by row reading and read its header
+int openRows(RowReader *reader, const char *fileName) {
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = open(fileName, O_RDONLY);
+    if (reader->fd < 0) {
+        fprintf(stderr, "Error opening file: %s\n", fileName);
+        return 1;
+    }
+    reader->capacity = 1 << 20;
+    reader->buffer = malloc(reader->capacity);
+    if (reader->buffer == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        close(reader->fd);
+        reader->fd = -1;
+        return 1;
+    }
+
+    while (reader->end < TMZ_HEADER_SIZE && fillRows(reader)) {
+        // Read at least the size of the binary header
+    }
+
+    const unsigned char *header = (const unsigned char *) reader->buffer;
+    if (reader->end >= TMZ_HEADER_SIZE && memcmp(header, TMZ_MAGIC, 4) == 0) {
+        uint32_t rows = getU32(header + 8);
+        uint32_t cols = getU32(header + 12);
+        if (getU32(header + 4) != TMZ_VERSION || rows == 0 || cols == 0 || rows > INT_MAX || cols > INT_MAX) {
+            return 1;
+        }
+        reader->binary = true;
+        reader->rows = (int) rows;
+        reader->cols = (int) cols;
+        reader->expected = getU32(header + 16);
+        reader->hash = 2166136261u;
+        // Payload offsets start after the header
+        memmove(reader->buffer, reader->buffer + TMZ_HEADER_SIZE, reader->end - TMZ_HEADER_SIZE);
+        reader->end -= TMZ_HEADER_SIZE;
+        return 0;
+    }
+
+    // Read the first line (definition of rows and columns), the number must not touch the end of the buffer
+    for (;;) {
+        const char *pos = reader->buffer;
+        const char *end = reader->buffer + reader->end;
+        bool complete = scanInt(&pos, end, &reader->rows) && scanInt(&pos, end, &reader->cols) &&
+                        (pos < end || reader->eof);
+        if (complete) {
+            reader->pos = (size_t) (pos - reader->buffer);
+            break;
+        }
+        if (!fillRows(reader)) {
+            return 1;
+        }
+    }
+    if (reader->rows <= 0 || reader->cols <= 0) {
+        return 1;
+    }
+    return 0;
+}
+
+// Decode the next row of the binary payload
+static int nextBinaryRow(RowReader *reader, unsigned char *row) {
+    size_t first = (size_t) reader->row * reader->cols;
+    size_t lastByte = packedSize(first + reader->cols);
+    while (reader->base + reader->end < lastByte) {
+        if (!fillRows(reader)) {
+            return 1;
+        }
+    }
+
+    const unsigned char *bytes = (const unsigned char *) reader->buffer;
+    for (int j = 0; j < reader->cols; j++) {
+        size_t bit = (first + j) * 3;
+        size_t index = (bit >> 3) - reader->base;
+        unsigned int pair = bytes[index];
+        if ((bit >> 3) + 1 < lastByte) {
+            pair |= (unsigned int) bytes[index + 1] << 8;
+        }
+        row[j] = (unsigned char) ((pair >> (bit & 7)) & 7);
+    }
+
+    // Keep the byte shared with the next row in the buffer
+    reader->pos = (first + reader->cols) * 3 / 8 - reader->base;
+    reader->row++;
+
+    // After the last row every payload byte has to be part of the checksum
+    if (reader->row == reader->rows) {
+        for (size_t k = reader->hashed - reader->base; k < lastByte - reader->base; k++) {
+            reader->hash = (reader->hash ^ (unsigned char) reader->buffer[k]) * 16777619u;
+        }
+        if (reader->hash != reader->expected) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Read the next row of cells, returns 1 if the input ends early or is malformed and 2 if a value is not 0-7
+int nextRow(RowReader *reader, unsigned char *row) {
+    if (reader->row >= reader->rows) {
+        return 1;
+    }
+    if (reader->binary) {
+        return nextBinaryRow(reader, row);
+    }
+
+    // Retry the row after refilling whenever it runs into the end of the buffer
+    for (;;) {
+        const char *pos = reader->buffer + reader->pos;
+        const char *end = reader->buffer + reader->end;
+        int failed = decodeCells(&pos, end, row, (size_t) reader->cols);
+        if (pos < end || reader->eof) {
+            if (failed) {
+                return failed;
+            }
+            reader->pos = (size_t) (pos - reader->buffer);
+            reader->row++;
+            return 0;
+        }
+        if (!fillRows(reader) && failed) {
+            return 1;
+        }
+    }
+}
+
+// Release the reader
+int closeRows(RowReader *reader) {
+    free(reader->buffer);
+    close(reader->fd);
+    reader->buffer = NULL;
+    reader->fd = -1;
+    return 0;
+}
+
+// Function that is testing the declaration of map, returns 1 if INVALID and 0 if VALID
+// Only two rows are kept in memory, bad borders are collected in errors (all of them or just the first one)
+int testMap(const char *fileName, bool all, ErrorList *errors) {
+    RowReader reader;
+    if (openRows(&reader, fileName)) {
+        if (reader.fd >= 0) {
+            closeRows(&reader);
+        }
+        return 1;
+    }
+
+    size_t stride = ((size_t) reader.cols + 63) / 64;
+    unsigned char *row = malloc((size_t) reader.cols);
+    uint64_t *words = malloc(4 * stride * sizeof(uint64_t));
+    if (row == NULL || words == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        free(row);
+        free(words);
+        closeRows(&reader);
+        return 1;
+    }
+    uint64_t *upper = words;
+    uint64_t *vertical = words + stride;
+    uint64_t *left = words + 2 * stride;
+    uint64_t *right = words + 3 * stride;
+
+    int result = 0;
+    for (int i = 0; i < reader.rows; i++) {
+        int failed = nextRow(&reader, row);
+        if (failed) {
+            if (failed == 2 && all) {
+                addError(errors, i + 1, badValue(row, reader.cols) + 1, BAD_VALUE);
+            }
+            result = 1;
+            break;
+        }
+
+        packRow(row, reader.cols, left, right, vertical);
+        int found = rowBorderErrors(i > 0 ? upper : NULL, left, right, vertical, i, reader.cols, all, errors);
+        if (found != 0) {
+            result = 1;
+            if (!all || found < 0) {
+                break;
+            }
+        }
+
+        uint64_t *swap = upper;
+        upper = vertical;
+        vertical = swap;
+    }
+
+    free(row);
+    free(words);
+    closeRows(&reader);
+    return result;
+}
+
+// Validator thread, checks its band of rows, the first row against the last row of the band above
+static void *checkBand(void *arg) {
+    BorderBand *band = arg;
+    const Map *map = band->map;
+    band->result = 0;
+
+    size_t stride = ((size_t) map->cols + 63) / 64;
+    uint64_t *words = malloc(4 * stride * sizeof(uint64_t));
+    if (words == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        band->result = 1;
+        return NULL;
+    }
+    uint64_t *upper = words;
+    uint64_t *vertical = words + stride;
+    uint64_t *left = words + 2 * stride;
+    uint64_t *right = words + 3 * stride;
+
+    if (band->first > 0) {
+        packRow(map->cells + (size_t) (band->first - 1) * map->cols, map->cols, left, right, upper);
+    }
+    for (int i = band->first; i < band->last; i++) {
+        const unsigned char *row = map->cells + (size_t) i * map->cols;
+        int bad = badValue(row, map->cols);
+        if (bad >= 0) {
+            if (band->all) {
+                addError(&band->errors, i + 1, bad + 1, BAD_VALUE);
+            }
+            band->result = 2;
+            break;
+        }
+
+        packRow(row, map->cols, left, right, vertical);
+        int found = rowBorderErrors(i > 0 ? upper : NULL, left, right, vertical, i, map->cols, band->all,
+                                    &band->errors);
+        if (found != 0) {
+            band->result = 1;
+            if (!band->all || found < 0) {
+                break;
+            }
+        }
+
+        uint64_t *swap = upper;
+        upper = vertical;
+        vertical = swap;
+    }
+    free(words);
+    return NULL;
+}
+
+// Check the whole map split into row bands, one per thread, errors of the bands are joined in row order
+int checkBands(const Map *map, bool all, ErrorList *errors) {
+    BorderBand bands[MAX_THREADS];
+    int count = (threadCount < map->rows) ? threadCount : map->rows;
+    for (int t = 0; t < count; t++) {
+        bands[t].map = map;
+        bands[t].first = (int) ((long long) map->rows * t / count);
+        bands[t].last = (int) ((long long) map->rows * (t + 1) / count);
+        bands[t].all = all;
+        bands[t].errors = (ErrorList) {NULL, 0, 0};
+    }
+    runWorkers(bands, sizeof(BorderBand), count, checkBand);
+
+    // Without all only the first band with a problem matters. A bad cell value (result 2) or running out of memory
+    // ends the list where testMap() stops reading, so the later bands are left out
+    int result = 0;
+    bool failed = false;
+    for (int t = 0; t < count; t++) {
+        if (bands[t].result && (all || result == 0) && !failed) {
+            for (size_t k = 0; k < bands[t].errors.count && !failed; k++) {
+                BorderError *error = &bands[t].errors.items[k];
+                failed = addError(errors, error->row, error->col, error->wall);
+            }
+            failed = failed || bands[t].result == 2;
+            result = 1;
+        }
+        freeErrors(&bands[t].errors);
+    }
+    return result;
+}
+
+// Same as testMap(), but the maze is loaded whole and checked by threadCount threads
+int testMapParallel(const char *fileName, bool all, ErrorList *errors) {
+    FileView view;
+    if (openView(&view, fileName)) {
+        return 1;
+    }
+
+    // The bands check the borders, only the checksum of a binary maze is left to do before them
+    Map maze;
+    int failed = !checksumMatches(&view) || parseMap(&maze, &view, false);
+    closeView(&view);
+    if (failed) {
+        return 1;
+    }
+    int result = checkBands(&maze, all, errors);
+    freeMap(&maze);
+    return result;
+}
+
+// Bit-plane map initialization, all walls start cleared
+int initBitMap(BitMap *map, int rows, int cols) {
+    map->rows = rows;
+    map->cols = cols;
+    map->stride = ((size_t) cols + 63) / 64;
+    size_t words = (size_t) rows * map->stride;
+    map->left = calloc(3 * words, sizeof(uint64_t));
+    if (map->left == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 1;
+    }
+    map->right = map->left + words;
+    map->vertical = map->right + words;
+    return 0;
+}
+
+// Destructor of bit-plane map
+int freeBitMap(BitMap *map) {
+    free(map->left);
+    map->rows = 0;
+    map->cols = 0;
+    map->stride = 0;
+    map->left = NULL;
+    map->right = NULL;
+    map->vertical = NULL;
+    return 0;
+}
+
+// Read and validate the maze straight into bit-planes, only one byte row is held at a time
+int loadBitMap(BitMap *map, const char *fileName) {
+    RowReader reader;
+    if (openRows(&reader, fileName)) {
+        if (reader.fd >= 0) {
+            closeRows(&reader);
+        }
+        return 1;
+    }
+
+    unsigned char *row = malloc((size_t) reader.cols);
+    if (row == NULL || initBitMap(map, reader.rows, reader.cols)) {
+        if (row == NULL) {
+            fprintf(stderr, "MALLOC_ERR\n");
+        }
+        free(row);
+        closeRows(&reader);
+        return 1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < reader.rows; i++) {
+        if (nextRow(&reader, row)) {
+            result = 1;
+            break;
+        }
+        size_t offset = (size_t) i * map->stride;
+        packRow(row, reader.cols, map->left + offset, map->right + offset, map->vertical + offset);
+        const uint64_t *upper = (i > 0) ? map->vertical + offset - map->stride : NULL;
+        if (rowBorderBits(upper, map->left + offset, map->right + offset, map->vertical + offset, i, map->cols) >= 0) {
+            result = 1;
+            break;
+        }
+    }
+
+    free(row);
+    closeRows(&reader);
+    if (result) {
+        freeBitMap(map);
+    }
+    return result;
+}
+
+// Spread the reached cells of one row along its open sides: a Kogge-Stone fill to the right and one to the
+// left, each word starting with the carry from its neighbour. Bit j of open is the side between j and j+1
+static void fillRow(uint64_t *reach, const uint64_t *right, int cols, size_t stride) {
+    uint64_t carry = 0;
+    for (size_t w = 0; w < stride; w++) {
+        uint64_t open = ~right[w] & columnMask(w, cols - 1);
+        uint64_t fill = reach[w] | carry;
+        uint64_t pass = open << 1;
+        for (int shift = 1; shift < 64; shift *= 2) {
+            fill |= pass & (fill << shift);
+            pass &= pass << shift;
+        }
+        reach[w] = fill;
+        carry = (fill & open) >> 63;
+    }
+
+    carry = 0;
+    for (size_t w = stride; w-- > 0; ) {
+        uint64_t open = ~right[w] & columnMask(w, cols - 1);
+        uint64_t fill = reach[w] | (carry & open);
+        uint64_t pass = open;
+        for (int shift = 1; shift < 64; shift *= 2) {
+            fill |= pass & (fill >> shift);
+            pass &= pass >> shift;
+        }
+        reach[w] = fill;
+        carry = (fill & 1) << 63;
+    }
+}
+
+// Move the reached cells of row i through their open vertical sides into row to (i - 1 for ▼ cells, i + 1 for
+// ▲ cells), returns true when row to got new cells
+static bool passRow(const BitMap *map, uint64_t *reach, int i, int to) {
+    uint64_t shape = (to < i) ? downMask(i) : ~downMask(i);
+    const uint64_t *vertical = map->vertical + (size_t) i * map->stride;
+    const uint64_t *from = reach + (size_t) i * map->stride;
+    uint64_t *into = reach + (size_t) to * map->stride;
+    bool grown = false;
+    for (size_t w = 0; w < map->stride; w++) {
+        uint64_t added = from[w] & ~vertical[w] & shape & ~into[w];
+        into[w] |= added;
+        grown |= (added != 0);
+    }
+    return grown;
+}
+
+// Flood fill from cell r, c over the bit-plane map into reach (rows * stride words, cleared by the caller).
+// Rows are filled 64 cells at a time and hand their cells to the rows above and below, sweeping down and up
+// over the rows that got new cells until no row changes
+int floodFill(const BitMap *map, uint64_t *reach, int r, int c) {
+    bool *dirty = calloc((size_t) map->rows, sizeof(bool));
+    if (dirty == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 1;
+    }
+    reach[(size_t) (r - 1) * map->stride + (size_t) (c - 1) / 64] |= (uint64_t) 1 << ((c - 1) % 64);
+    dirty[r - 1] = true;
+
+    size_t pending = 1;
+    for (bool down = true; pending > 0; down = !down) {
+        for (int k = 0; k < map->rows; k++) {
+            int i = down ? k : map->rows - 1 - k;
+            if (!dirty[i]) {
+                continue;
+            }
+            dirty[i] = false;
+            pending--;
+            fillRow(reach + (size_t) i * map->stride, map->right + (size_t) i * map->stride, map->cols,
+                    map->stride);
+            for (int to = i - 1; to <= i + 1; to += 2) {
+                if (to >= 0 && to < map->rows && passRow(map, reach, i, to) && !dirty[to]) {
+                    dirty[to] = true;
+                    pending++;
+                }
+            }
+        }
+    }
+    free(dirty);
+    return 0;
+}
+
+// Some open border edge other than the one the start r, c is entered through has a reached cell
+bool exitReached(const BitMap *map, const uint64_t *reach, int r, int c) {
+    const size_t stride = map->stride;
+    const size_t last = (size_t) (map->rows - 1) * stride;
+    const size_t edge = (size_t) (map->cols - 1) / 64;
+    const uint64_t edgeBit = (uint64_t) 1 << ((map->cols - 1) % 64);
+
+    // Entry side picked like start_border() does, cleared from a copy of the start cell's walls
+    size_t startWord = (size_t) (r - 1) * stride + (size_t) (c - 1) / 64;
+    uint64_t startBit = (uint64_t) 1 << ((c - 1) % 64);
+    int entry = 0;
+    if (c == 1 && !(map->left[startWord] & startBit)) {
+        entry = WALL_L;
+    } else if (c == map->cols && !(map->right[startWord] & startBit)) {
+        entry = WALL_R;
+    } else if ((r == 1 || r == map->rows) && !(map->vertical[startWord] & startBit)) {
+        entry = WALL_V;
+    }
+
+    for (size_t w = 0; w < stride; w++) {
+        uint64_t up = reach[w] & ~map->vertical[w] & downMask(0) & columnMask(w, map->cols);
+        uint64_t down = reach[last + w] & ~map->vertical[last + w] & ~downMask(map->rows - 1) &
+                        columnMask(w, map->cols);
+        if (entry == WALL_V && r == 1 && w == startWord - (size_t) (r - 1) * stride) {
+            up &= ~startBit;
+        }
+        if (entry == WALL_V && r == map->rows && w == startWord - last) {
+            down &= ~startBit;
+        }
+        if (up != 0 || down != 0) {
+            return true;
+        }
+    }
+    for (int i = 0; i < map->rows; i++) {
+        size_t row = (size_t) i * stride;
+        bool leftOpen = (reach[row] & ~map->left[row] & 1) != 0 && !(entry == WALL_L && i == r - 1);
+        bool rightOpen = (reach[row + edge] & ~map->right[row + edge] & edgeBit) != 0 &&
+                         !(entry == WALL_R && i == r - 1);
+        if (leftOpen || rightOpen) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Write the map as a binary maze
+int writeBinary(const Map *map, const char *fileName) {
+    size_t size = packedSize((size_t) map->rows * map->cols);
+    unsigned char *payload = malloc(size > 0 ? size : 1);
+    if (payload == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 1;
+    }
+    packCells(map->cells, (size_t) map->rows * map->cols, payload);
+
+    unsigned char header[TMZ_HEADER_SIZE];
+    memcpy(header, TMZ_MAGIC, 4);
+    putU32(header + 4, TMZ_VERSION);
+    putU32(header + 8, (uint32_t) map->rows);
+    putU32(header + 12, (uint32_t) map->cols);
+    putU32(header + 16, checksum(payload, size));
+
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file: %s\n", fileName);
+        free(payload);
+        return 1;
+    }
+    bool ok = fwrite(header, 1, TMZ_HEADER_SIZE, file) == TMZ_HEADER_SIZE && fwrite(payload, 1, size, file) == size;
+    ok = (fclose(file) == 0) && ok;
+    free(payload);
+    if (!ok) {
+        fprintf(stderr, "Error writing file: %s\n", fileName);
+        return 1;
+    }
+    return 0;
+}
+
+// Write the map in the text format
+int writeText(const Map *map, const char *fileName) {
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening file: %s\n", fileName);
+        return 1;
+    }
+
+    char *line = malloc((size_t) map->cols * 2);
+    if (line == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        fclose(file);
+        return 1;
+    }
+
+    bool ok = fprintf(file, "%d %d\n", map->rows, map->cols) > 0;
+    for (int i = 0; i < map->rows && ok; i++) {
+        const unsigned char *row = map->cells + (size_t) i * map->cols;
+        for (int j = 0; j < map->cols; j++) {
+            line[2 * j] = (char) ('0' + row[j]);
+            line[2 * j + 1] = ' ';
+        }
+        line[2 * (size_t) map->cols - 1] = '\n';
+        ok = fwrite(line, 1, (size_t) map->cols * 2, file) == (size_t) map->cols * 2;
+    }
+    free(line);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "Error writing file: %s\n", fileName);
+        return 1;
+    }
+    return 0;
+}
+
+// Convert text maze to binary and binary maze to text
+int convertMap(const char *inName, const char *outName) {
+    FileView view;
+    if (openView(&view, inName)) {
+        return 1;
+    }
+    bool toText = isBinary(&view);
+
+    Map maze;
+    int result = parseMap(&maze, &view, true);
+    closeView(&view);
+    if (result) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
+
+    result = toText ? writeText(&maze, outName) : writeBinary(&maze, outName);
+    freeMap(&maze);
+    return result;
+}
+
+// Check if there is a way how to enter maze
+bool entryPossible (Map *map, int r, int c) {
+    if (r == 1 || r == map->rows || c == 1 || c == map->cols) {
+        if ((r == 1 && c == 1) || (r == map->rows && c == 1)) {
+            if (((((map->cells[((r - 1) * map->cols) + c]) >> 0) & 1) == 1) &&
+                ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1)) {
+                printf("Not possible to enter maze");
+                return false;
+            }
+        }
+
+        if ((r == 1 && c == map->cols) || (r == map->rows && c == map->cols)) {
+            if (((((map->cells[((r - 1) * map->cols) + c]) >> 1) & 1) == 1) &&
+                ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1)) {
+                printf("Not possible to enter maze");
+                return false;
+            }
+
+            if (c == 1) {
+                if ((((map->cells[((r - 1) * map->cols) + c]) >> 0) & 1) == 1) {
+                    printf("Not possible to enter maze");
+                    return false;
+                }
+            }
+            if (c == map->cols) {
+                if ((((map->cells[((r - 1) * map->cols) + c]) >> 1) & 1) == 1) {
+                    printf("Not possible to enter maze");
+                    return false;
+                }
+            }
+
+            if (r == 1) {
+                if ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1) {
+                    printf("Not possible to enter maze");
+                    return false;
+                }
+            }
+            if (r == map->rows) {
+                if ((((map->cells[((r - 1) * map->cols) + c]) >> 2) & 1) == 1) {
+                    printf("Not possible to enter maze");
+                    return false;
+                }
+            } else {
+                printf("Not possible to enter maze");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Check borders of cell
+bool isborder(Map *map, int r, int c, int border) {
+    unsigned char value = map->cells[(((r - 1) * map->cols) + (c-1))];
+    if (border == LEFT_WALL) {
+        if (((value >> 0) & 1) == 1) {
+            return true;
+        }
+    } else if (border == RIGHT_WALL) {
+        if (((value>> 1) & 1) == 1) {
+            return true;
+        }
+    } else {
+        if (((value >> 2) & 1) == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Control of the side from which we enter the cell and the cells borders
+int start_border(Map *map, int r, int c, int leftright) {
+    bool borderL = isborder(map, r, c, 0);
+    bool borderR = isborder(map, r, c, 1);
+    bool borderUL = isborder(map, r, c, 2);
+
+    if ((leftright == RIGHT_HAND) || (leftright == LEFT_HAND)) {
+        if (c == 1) {
+            if (borderL == false) {
+                return STEP_INTO_FROM_LEFT;
+            }
+        }
+        if (c == map->cols) {
+            if (borderR == false) {
+                return STEP_INTO_FROM_RIGHT;
+            }
+        }
+        if (r == 1) {
+            if (borderUL == false) {
+                return STEP_INTO_FROM_UP;
+            }
+        }
+        if (r == map->rows) {
+            if (borderUL == false) {
+                return STEP_INTO_FROM_DOWN;
+            }
+        }
+    }
+    return -1;
+}
+
+// Prepare the path writer for fd, anything already printed through stdio goes out first
+int initWriter(PathWriter *out, int fd, int format) {
+    fflush(stdout);
+    out->fd = fd;
+    out->format = format;
+    out->length = 0;
+    out->failed = false;
+    out->bits = 0;
+    out->pending = 0;
+    out->moves = 0;
+    out->buffer = malloc(WRITER_SIZE);
+    if (out->buffer == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Hand the buffered bytes to the kernel
+int flushWriter(PathWriter *out) {
+    size_t done = 0;
+    while (done < out->length && !out->failed) {
+        ssize_t written = write(out->fd, out->buffer + done, out->length - done);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            out->failed = true;
+            break;
+        }
+        done += (size_t) written;
+    }
+    out->length = 0;
+    return out->failed ? 1 : 0;
+}
+
+// Flush and release the writer, returns 1 if some write failed
+int closeWriter(PathWriter *out) {
+    flushWriter(out);
+    free(out->buffer);
+    out->buffer = NULL;
+    return out->failed ? 1 : 0;
+}
+
+// Append a non-negative number in decimal
+static inline void putNumber(PathWriter *out, unsigned long long value) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0) {
+        out->buffer[out->length++] = digits[--count];
+    }
+}
+
+// Append one "R,C" line of the path
+static inline void writeCell(PathWriter *out, int row, int col) {
+    if (out->length > WRITER_SIZE - 32) {
+        flushWriter(out);
+    }
+    putNumber(out, (unsigned long long) row);
+    out->buffer[out->length++] = ',';
+    putNumber(out, (unsigned long long) col);
+    out->buffer[out->length++] = '\n';
+}
+
+// Begin a path at its start cell, the cell format leaves that to the walker
+void writeStart(PathWriter *out, int row, int col) {
+    if (out->format == FORMAT_MOVES) {
+        writeCell(out, row, col);
+    } else if (out->format == FORMAT_BIN) {
+        memcpy(out->buffer + out->length, PATH_MAGIC, 3);
+        out->buffer[out->length + 3] = PATH_VERSION;
+        putU32((unsigned char *) out->buffer + out->length + 4, (uint32_t) row);
+        putU32((unsigned char *) out->buffer + out->length + 8, (uint32_t) col);
+        out->length += PATH_HEADER_SIZE;
+    }
+}
+
+// Append one step (STEP_INTO_FROM_*) as a letter
+static inline void writeLetter(PathWriter *out, int step) {
+    if (out->length > WRITER_SIZE - 32) {
+        flushWriter(out);
+    }
+    out->buffer[out->length++] = "?LRUD"[step];
+}
+
+// Append one step as 2 bits, the first step of a byte goes to the lowest bits
+static inline void writeBits(PathWriter *out, int step) {
+    out->bits |= (unsigned) (step - 1) << (2 * out->pending);
+    out->moves++;
+    if (++out->pending == 4) {
+        if (out->length > WRITER_SIZE - 32) {
+            flushWriter(out);
+        }
+        out->buffer[out->length++] = (char) out->bits;
+        out->bits = 0;
+        out->pending = 0;
+    }
+}
+
+// Append the step into row, col in the writer's format
+void writeStep(PathWriter *out, int step, int row, int col) {
+    if (out->format == FORMAT_CELLS) {
+        writeCell(out, row, col);
+    } else if (out->format == FORMAT_MOVES) {
+        writeLetter(out, step);
+    } else if (out->format == FORMAT_BIN) {
+        writeBits(out, step);
+    }
+}
+
+// Terminate a moves line or write the last partial byte and the trailer of a bin path
+void writeEnd(PathWriter *out) {
+    if (out->length > WRITER_SIZE - 32) {
+        flushWriter(out);
+    }
+    if (out->format == FORMAT_MOVES) {
+        out->buffer[out->length++] = '\n';
+    } else if (out->format == FORMAT_BIN) {
+        if (out->pending > 0) {
+            out->buffer[out->length++] = (char) out->bits;
+        }
+        unsigned char *trailer = (unsigned char *) out->buffer + out->length;
+        putU32(trailer, (uint32_t) out->moves);
+        putU32(trailer + 4, (uint32_t) (out->moves >> 32));
+        out->length += PATH_TRAILER_SIZE;
+    }
+}
+
+// Put the walk at its start cell, the first step comes from start_border()
+int initWalk(Map *map, Walk *walk, int r, int c, int hand) {
+    walk->row = r;
+    walk->col = c;
+    walk->index = 0;
+    walk->step = 0;
+    walk->steps = 0;
+    walk->pause = ULLONG_MAX;
+    walk->status = WALK_EXITED;
+    walk->cycles = CYCLES_OFF;
+    walk->seen = NULL;
+    if (r > 0 && c > 0 && r <= map->rows && c <= map->cols) {
+        walk->index = (size_t) (r - 1) * map->cols + (c - 1);
+        walk->step = start_border(map, r, c, hand);
+        walk->status = WALK_RUNNING;
+    }
+    return 0;
+}
+
+// Choose the cycle detector and record the start state in it, auto takes the bitset unless it is too big
+int initCycles(const Map *map, Walk *walk, int mode) {
+    size_t words = ((size_t) map->rows * map->cols * 4 + 63) / 64;
+    if (mode == CYCLES_AUTO) {
+        mode = (words * sizeof(uint64_t) <= CYCLES_BITSET_LIMIT) ? CYCLES_BITSET : CYCLES_BRENT;
+    }
+    if (walk->status != WALK_RUNNING || walk->step < STEP_INTO_FROM_LEFT || walk->step > STEP_INTO_FROM_DOWN) {
+        mode = CYCLES_OFF;
+    }
+
+    if (mode == CYCLES_BITSET) {
+        walk->seen = calloc(words, sizeof(uint64_t));
+        if (walk->seen == NULL) {
+            fprintf(stderr, "MALLOC_ERR\n");
+            return 1;
+        }
+        size_t bit = walk->index * 4 + (size_t) (walk->step - 1);
+        walk->seen[bit / 64] |= (uint64_t) 1 << (bit % 64);
+    }
+    walk->savedIndex = walk->index;
+    walk->savedStep = walk->step;
+    walk->power = 1;
+    walk->lambda = 0;
+    walk->cycles = mode;
+    return 0;
+}
+
+// Release the cycle detector
+int freeWalk(Walk *walk) {
+    free(walk->seen);
+    walk->seen = NULL;
+    return 0;
+}
+
+// One step of the walk in a cell of known shape: report the cell, look the next step up and move the linear
+// index with it, the row/col bookkeeping is only needed for leaving the maze and for the output
+#define WALK_STEP(rule) \
+    do { \
+        if (emit == FORMAT_CELLS) { \
+            writeCell(out, row, col); \
+        } \
+        next = (rule)[step - 1][cells[index] & 7]; \
+        if (next == 0) { \
+            status = WALK_STUCK; \
+            goto done; \
+        } \
+        int nextRow = row + rowDelta[next]; \
+        int nextCol = col + colDelta[next]; \
+        step = next; \
+        if (nextRow < 1 || nextRow > rows || nextCol < 1 || nextCol > cols) { \
+            status = WALK_EXITED; \
+            goto done; \
+        } \
+        row = nextRow; \
+        col = nextCol; \
+        index += indexDelta[next]; \
+        steps++; \
+        if (cycles == CYCLES_BITSET) { \
+            size_t bit = index * 4 + (size_t) (next - 1); \
+            uint64_t mask = (uint64_t) 1 << (bit % 64); \
+            if (seen[bit / 64] & mask) { \
+                status = WALK_CYCLE; \
+                goto done; \
+            } \
+            seen[bit / 64] |= mask; \
+        } else if (cycles == CYCLES_BRENT) { \
+            lambda++; \
+            if (index == savedIndex && next == savedStep) { \
+                status = WALK_CYCLE; \
+                goto done; \
+            } \
+            if (lambda == power) { \
+                savedIndex = index; \
+                savedStep = next; \
+                power *= 2; \
+                lambda = 0; \
+            } \
+        } \
+        if (emit == FORMAT_MOVES) { \
+            writeLetter(out, next); \
+        } else if (emit == FORMAT_BIN) { \
+            writeBits(out, next); \
+        } \
+        if (steps >= pause) { \
+            status = WALK_PAUSED; \
+            goto done; \
+        } \
+    } while (0)
+
+// Walker engine, every call site passes constants so each hand and output format gets its own hot loop. Every step changes the
+// shape of the cell, so the loop body is unrolled into a ▼ half and a ▲ half with the rule row fixed in each
+static inline __attribute__((always_inline)) void walkCore(const Map *map, Walk *walk, PathWriter *out,
+                                                          const int hand, const int emit, const int cycles) {
+    const unsigned char (*down)[8] = transitions[0][hand];
+    const unsigned char (*up)[8] = transitions[1][hand];
+    const unsigned char *cells = map->cells;
+    const int rows = map->rows;
+    const int cols = map->cols;
+    const long long indexDelta[5] = {0, 1, -1, cols, -(long long) cols};
+
+    int row = walk->row;
+    int col = walk->col;
+    size_t index = walk->index;
+    int step = walk->step;
+    unsigned long long steps = walk->steps;
+    const unsigned long long pause = walk->pause;
+    int status = WALK_RUNNING;
+    int next;
+    uint64_t *seen = walk->seen;
+    size_t savedIndex = walk->savedIndex;
+    int savedStep = walk->savedStep;
+    unsigned long long power = walk->power;
+    unsigned long long lambda = walk->lambda;
+
+    if (walk->status != WALK_RUNNING) {
+        return;
+    }
+    if (step < STEP_INTO_FROM_LEFT || step > STEP_INTO_FROM_DOWN) {
+        if (emit == FORMAT_CELLS) {
+            writeCell(out, row, col);
+        }
+        status = WALK_STUCK;
+        goto done;
+    }
+    if ((row + col) % 2 != 0) {
+        goto shapeUp;
+    }
+    for (;;) {
+        WALK_STEP(down);
+    shapeUp:
+        WALK_STEP(up);
+    }
+
+done:
+    walk->row = row;
+    walk->col = col;
+    walk->index = index;
+    walk->step = step;
+    walk->steps = steps;
+    walk->status = status;
+    walk->savedIndex = savedIndex;
+    walk->savedStep = savedStep;
+    walk->power = power;
+    walk->lambda = lambda;
+}
+
+// Specialized walkers
+#define DEFINE_WALKER(name, hand, emit, cycles) \
+    void name(const Map *map, Walk *walk, PathWriter *out) { \
+        walkCore(map, walk, out, hand, emit, cycles); \
+    }
+
+// Both hands for one output format and cycle detector
+#define DEFINE_WALKERS(name, emit, cycles) \
+    DEFINE_WALKER(walkRight##name, RIGHT_HAND, emit, cycles) \
+    DEFINE_WALKER(walkLeft##name, LEFT_HAND, emit, cycles)
+
+#define WALKER_ROW(name) {walkRight##name, walkLeft##name}
+
+DEFINE_WALKERS(Cells, FORMAT_CELLS, CYCLES_OFF)
+DEFINE_WALKERS(Moves, FORMAT_MOVES, CYCLES_OFF)
+DEFINE_WALKERS(Bin, FORMAT_BIN, CYCLES_OFF)
+DEFINE_WALKERS(Quiet, FORMAT_NONE, CYCLES_OFF)
+DEFINE_WALKERS(QuietBitset, FORMAT_NONE, CYCLES_BITSET)
+DEFINE_WALKERS(QuietBrent, FORMAT_NONE, CYCLES_BRENT)
+
+// Walkers by [cycles][format][hand]. Only --cycles asks for a detector, so it is only built into the quiet walker
+// and a walk with output replays the steps the quiet one found (see runWalk())
+void (*const walkers[3][4][2])(const Map *, Walk *, PathWriter *) = {
+    {WALKER_ROW(Cells), WALKER_ROW(Moves), WALKER_ROW(Bin), WALKER_ROW(Quiet)},
+    {{NULL, NULL}, {NULL, NULL}, {NULL, NULL}, WALKER_ROW(QuietBitset)},
+    {{NULL, NULL}, {NULL, NULL}, {NULL, NULL}, WALKER_ROW(QuietBrent)},
+};
+
+// Monotonic time in seconds
+double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec + (double) time.tv_nsec / 1e9;
+}
+
+// Run the walk with a walker of the given format, split into blocks so that the step budget and the deadline
+// (0 when not set) are only checked between blocks. With a cycle detector and an output format the quiet walker
+// finds the first repeated state, then the walk with output is replayed up to it and ends there as WALK_CYCLE
+int runWalk(const Map *map, Walk *walk, PathWriter *out, int format, int hand, const Options *options,
+            double deadline) {
+    unsigned long long budget = (options->maxSteps > 0) ? options->maxSteps : ULLONG_MAX;
+    unsigned long long cycleAt = ULLONG_MAX;
+    if (walk->cycles != CYCLES_OFF && format != FORMAT_NONE) {
+        Walk probe = *walk;
+        runWalk(map, &probe, NULL, FORMAT_NONE, hand, options, deadline);
+        if (probe.status == WALK_CYCLE) {
+            cycleAt = probe.steps;
+            budget = cycleAt;
+        }
+    }
+    int cycles = (format == FORMAT_NONE) ? walk->cycles : CYCLES_OFF;
+    void (*walker)(const Map *, Walk *, PathWriter *) = walkers[cycles][format][hand];
+
+    for (;;) {
+        walk->pause = budget;
+        if (deadline > 0 && budget - walk->steps > WALK_CHECK_STEPS) {
+            walk->pause = walk->steps + WALK_CHECK_STEPS;
+        }
+        walker(map, walk, out);
+        if (walk->status != WALK_PAUSED) {
+            return 0;
+        }
+        if (walk->steps == cycleAt) {
+            walk->status = WALK_CYCLE;
+            return 0;
+        }
+        if (walk->steps >= budget || (deadline > 0 && now() >= deadline)) {
+            walk->status = WALK_LIMIT;
+            return 0;
+        }
+        walk->status = WALK_RUNNING;
+    }
+}
+
+// Walk without any output and print where it ended, how many steps it took and how long
+int summarizeWalk(const Map *maze, Walk *walk, int hand, const Options *options, double deadline) {
+    bool outside = (walk->status != WALK_RUNNING);
+    double start = now();
+    runWalk(maze, walk, NULL, FORMAT_NONE, hand, options, deadline);
+    double elapsed = now() - start;
+
+    const char *result = (walk->status == WALK_STUCK) ? "stuck" : (walk->status == WALK_CYCLE) ? "cycle" :
+                         (walk->status == WALK_LIMIT) ? "limit" : outside ? "outside" : "exit";
+    printf("%s %d,%d steps %llu time %.6f s\n", result, walk->row, walk->col, walk->steps, elapsed);
+    return 0;
+}
+
+// The first step of the walk crosses an open outer side of its start cell. Such a walk cannot run in a circle:
+// the right-hand walks from the open outer sides are disjoint and each ends at an outer side or gets stuck,
+// and a left-hand one retraces one of them backwards (see solveExitTable())
+static inline bool frameEntry(const Map *map, const Walk *walk) {
+    int step = walk->step;
+    if (walk->status != WALK_RUNNING || step < STEP_INTO_FROM_LEFT || step > STEP_INTO_FROM_DOWN) {
+        return false;
+    }
+    int r = walk->row;
+    int c = walk->col;
+    int w = (step == STEP_INTO_FROM_LEFT) ? WALL_L : (step == STEP_INTO_FROM_RIGHT) ? WALL_R : WALL_V;
+    bool outer = (w == WALL_L) ? c == 1 : (w == WALL_R) ? c == map->cols : ((r + c) % 2 == 0) ? r == 1 : r == map->rows;
+    return outer && !(map->cells[walk->index] & w) && 1 + ((EXIT_SIDE((r + c) % 2, w) - 1) ^ 1) == step;
+}
+
+// Solving maze with the given rule, the path is printed cell by cell. Returns EXIT_LIMIT when --max-steps or
+// --deadline-ms cut it short. Only with --cycles is the walk watched for coming back to a (cell, entry step)
+// state, it then stops there and returns EXIT_CYCLE. A walk that enters through an open outer side is never
+// watched, it always ends. --length prints how the walk ends instead of the path and always watches the others
+int solveMaze(int r, int c, int hand, const Options *options, const char *fileName) {
+    double deadline = (options->deadlineMs > 0) ? now() + (double) options->deadlineMs / 1000 : 0;
+    Map maze;
+    if (loadMap(&maze, fileName)) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
+
+    if ((entryPossible(&maze, r, c)) == false) {
+        freeMap(&maze);
+        return 1;
+    }
+
+    Walk walk;
+    initWalk(&maze, &walk, r, c, hand);
+    int cycles = frameEntry(&maze, &walk) ? CYCLES_OFF : (options->length && options->cycles == CYCLES_OFF) ?
+                 CYCLES_BRENT : options->cycles;
+    if (initCycles(&maze, &walk, cycles)) {
+        freeMap(&maze);
+        return 1;
+    }
+
+    int result = 0;
+    if (options->length) {
+        runWalk(&maze, &walk, NULL, FORMAT_NONE, hand, options, deadline);
+        const char *end = (walk.status == WALK_STUCK) ? "stuck" : (walk.status == WALK_CYCLE) ? "cycle" :
+                          (walk.status == WALK_LIMIT) ? "limit" : "exit";
+        printf("%s %d,%d steps %llu\n", end, walk.row, walk.col, walk.steps);
+    } else if (options->format == FORMAT_NONE) {
+        summarizeWalk(&maze, &walk, hand, options, deadline);
+    } else {
+        PathWriter out;
+        if (initWriter(&out, STDOUT_FILENO, options->format)) {
+            freeWalk(&walk);
+            freeMap(&maze);
+            return 1;
+        }
+
+        writeStart(&out, r, c);
+        runWalk(&maze, &walk, &out, options->format, hand, options, deadline);
+
+        // A walk stuck in its start cell reports the start twice, like the original history check did
+        if (options->format == FORMAT_CELLS && walk.status == WALK_STUCK && walk.steps == 0) {
+            writeCell(&out, walk.row, walk.col);
+        }
+        // The cell reached by the last allowed step has not been reported yet
+        if (options->format == FORMAT_CELLS && walk.status == WALK_LIMIT) {
+            writeCell(&out, walk.row, walk.col);
+        }
+        writeEnd(&out);
+        result = closeWriter(&out);
+    }
+
+    if (walk.status == WALK_CYCLE) {
+        fprintf(stderr, "Path never leaves the maze, it loops through %d,%d after %llu steps\n",
+                walk.row, walk.col, walk.steps);
+        result = EXIT_CYCLE;
+    } else if (walk.status == WALK_LIMIT) {
+        const char *limit = (options->maxSteps > 0 && walk.steps >= options->maxSteps) ? "Step limit" : "Deadline";
+        fprintf(stderr, "%s reached at %d,%d after %llu steps\n", limit, walk.row, walk.col, walk.steps);
+        result = EXIT_LIMIT;
+    }
+    freeWalk(&walk);
+    freeMap(&maze);
+    return result;
+}
+
+// Solving maze according to right-hand rule
+int solveMazeR(int r, int c, const Options *options, const char *fileName) {
+    return solveMaze(r, c, RIGHT_HAND, options, fileName);
+}
+
+// Solving maze according to left-hand rule
+int solveMazeL(int r, int c, const Options *options, const char *fileName) {
+    return solveMaze(r, c, LEFT_HAND, options, fileName);
+}
+
+// Open sides of the cell at r, c that lead out of the maze, as WALL_* bits
+static inline int exitSides(const Map *map, int r, int c) {
+    int walls = map->cells[(size_t) (r - 1) * map->cols + (c - 1)];
+    int sides = 0;
+    if (c == 1 && !(walls & WALL_L)) {
+        sides |= WALL_L;
+    }
+    if (c == map->cols && !(walls & WALL_R)) {
+        sides |= WALL_R;
+    }
+    if (!(walls & WALL_V) && (((r + c) % 2 == 0) ? r == 1 : r == map->rows)) {
+        sides |= WALL_V;
+    }
+    return sides;
+}
+
+// Wall side the maze is entered through at r, c (as start_border() picks it), 0 for an inner cell
+int entrySide(Map *map, int r, int c) {
+    int step = start_border(map, r, c, RIGHT_HAND);
+    return (step == STEP_INTO_FROM_LEFT) ? WALL_L : (step == STEP_INTO_FROM_RIGHT) ? WALL_R :
+           (step == STEP_INTO_FROM_UP || step == STEP_INTO_FROM_DOWN) ? WALL_V : 0;
+}
+
+// Step that moves out of a cell through the open side w, the vertical side depends on the shape
+static inline int sideStep(int row, int col, int w) {
+    return EXIT_SIDE((row + col) % 2, w);
+}
+
+// Step stored in a 2-bit parent array
+static inline int parentStep(const unsigned char *parents, size_t index) {
+    return ((parents[index / 4] >> (2 * (index % 4))) & 3) + 1;
+}
+
+// Linear index of the neighbour reached by step
+static inline size_t stepIndex(const Map *map, size_t index, int step) {
+    return index + rowDelta[step] * (long long) map->cols + colDelta[step];
+}
+
+// Neighbour of the cell at index (row, col) through its side w, SIZE_MAX when the side is a wall or leads out
+// of the maze. step gets the step into the neighbour
+static inline size_t sideNeighbour(const Map *map, size_t index, int row, int col, int w, int *step) {
+    if (map->cells[index] & w) {
+        return SIZE_MAX;
+    }
+    *step = sideStep(row, col, w);
+    int nextRow = row + rowDelta[*step];
+    int nextCol = col + colDelta[*step];
+    if (nextRow < 1 || nextRow > map->rows || nextCol < 1 || nextCol > map->cols) {
+        return SIZE_MAX;
+    }
+    return stepIndex(map, index, *step);
+}
+
+// Cell at index is an exit of the search started at start, whose entry side does not count
+static inline bool isExitCell(const Map *map, size_t index, size_t start, int entry) {
+    int sides = exitSides(map, (int) (index / map->cols) + 1, (int) (index % map->cols) + 1);
+    return (index == start) ? (sides & ~entry) != 0 : sides != 0;
+}
+
+// Collect the route start -> meet (parents hold the step into each cell) and, with back, meet -> exit (back
+// holds the step towards the exit). Returns the step count, steps is left NULL when it could not be allocated
+size_t collectRoute(const Map *map, const unsigned char *parents, const unsigned char *back, size_t start,
+                    size_t meet, int entry, unsigned char **steps) {
+    size_t head = 0;
+    for (size_t index = meet; index != start; head++) {
+        index = stepIndex(map, index, 1 + ((parentStep(parents, index) - 1) ^ 1));
+    }
+    size_t tail = 0;
+    for (size_t index = meet; back != NULL && !isExitCell(map, index, start, entry); tail++) {
+        index = stepIndex(map, index, parentStep(back, index));
+    }
+
+    *steps = malloc(head + tail + 1);
+    if (*steps == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 0;
+    }
+    size_t k = head;
+    for (size_t index = meet; index != start; ) {
+        int step = parentStep(parents, index);
+        (*steps)[--k] = (unsigned char) step;
+        index = stepIndex(map, index, 1 + ((step - 1) ^ 1));
+    }
+    k = head;
+    for (size_t index = meet; back != NULL && !isExitCell(map, index, start, entry); ) {
+        int step = parentStep(back, index);
+        (*steps)[k++] = (unsigned char) step;
+        index = stepIndex(map, index, step);
+    }
+    return head + tail;
+}
+
+// Print a route of length steps from start
+int writeRoute(const Map *map, const unsigned char *steps, size_t length, size_t start, PathWriter *out) {
+    int row = (int) (start / map->cols) + 1;
+    int col = (int) (start % map->cols) + 1;
+    writeStart(out, row, col);
+    if (out->format == FORMAT_CELLS) {
+        writeCell(out, row, col);
+    }
+    for (size_t k = 0; k < length; k++) {
+        row += rowDelta[steps[k]];
+        col += colDelta[steps[k]];
+        writeStep(out, steps[k], row, col);
+    }
+    writeEnd(out);
+    return 0;
+}
+
+// Visit the cell at next from a search, returns false when it was visited before. parents gets step, the
+// step into next for the forward search or the step back out of it for the search from the exits
+static inline bool visitCell(uint64_t *visited, unsigned char *parents, size_t next, int step) {
+    uint64_t mask = (uint64_t) 1 << (next % 64);
+    if (visited[next / 64] & mask) {
+        return false;
+    }
+    visited[next / 64] |= mask;
+    parents[next / 4] |= (unsigned char) ((step - 1) << (2 * (next % 4)));
+    return true;
+}
+
+// Expand one BFS level, the queue entries [*head, *tail) at the call. With other set, stops at the first new
+// cell the other search has already seen and returns it, otherwise SIZE_MAX. reverse stores the step back
+static size_t expandLevel(const Map *map, uint32_t *queue, size_t *head, size_t *tail, uint64_t *visited,
+                          unsigned char *parents, const uint64_t *other, bool reverse) {
+    const int cols = map->cols;
+    size_t end = *tail;
+    for (; *head < end; (*head)++) {
+        size_t index = queue[*head];
+        int row = (int) (index / cols) + 1;
+        int col = (int) (index % cols) + 1;
+        for (int w = WALL_L; w <= WALL_V; w <<= 1) {
+            int step;
+            size_t next = sideNeighbour(map, index, row, col, w, &step);
+            if (next == SIZE_MAX || !visitCell(visited, parents, next, reverse ? 1 + ((step - 1) ^ 1) : step)) {
+                continue;
+            }
+            queue[(*tail)++] = (uint32_t) next;
+            if (other != NULL && (other[next / 64] >> (next % 64) & 1)) {
+                (*head)++;
+                return next;
+            }
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Breadth-first search from start to the nearest open border edge other than the one the start is entered
+// through (entry). visited has a bit per cell, parents 2 bits per cell and the queue is preallocated for
+// every cell, each cell enters it at most once. Returns the exit cell, SIZE_MAX when no exit is reachable
+size_t searchExit(const Map *map, size_t start, int entry, uint64_t *visited, unsigned char *parents,
+                  uint32_t *queue, size_t *touched) {
+    size_t head = 0;
+    size_t tail = 0;
+    size_t found = SIZE_MAX;
+
+    visited[start / 64] |= (uint64_t) 1 << (start % 64);
+    queue[tail++] = (uint32_t) start;
+    while (head < tail) {
+        size_t level = tail;
+        for (size_t k = head; k < level && found == SIZE_MAX; k++) {
+            if (isExitCell(map, queue[k], start, entry)) {
+                found = queue[k];
+            }
+        }
+        if (found != SIZE_MAX) {
+            break;
+        }
+        expandLevel(map, queue, &head, &tail, visited, parents, NULL, false);
+    }
+    *touched = tail;
+    return found;
+}
+
+// Add a cell to the next level of a band and remember the lowest exit cell reached
+static inline void claimCell(BfsBand *band, size_t index, int row, int col, int step) {
+    band->visited[index / 64] |= (uint64_t) 1 << (index % 64);
+    band->parents[index / 4] |= (unsigned char) ((step - 1) << (2 * (index % 4)));
+    band->next[band->first * 64 + band->added++] = (uint32_t) index;
+    if (index < band->found && exitSides(band->map, row, col) != 0) {
+        band->found = index;
+    }
+}
+
+// Put the current cells of a band into the frontier bitset for a bottom-up level
+static void *markBand(void *arg) {
+    BfsBand *band = arg;
+    const uint32_t *list = band->current + band->first * 64;
+    memset(band->frontier + band->first, 0, (band->last - band->first) * sizeof(uint64_t));
+    for (size_t k = 0; k < band->size; k++) {
+        band->frontier[list[k] / 64] |= (uint64_t) 1 << (list[k] % 64);
+    }
+    return NULL;
+}
+
+// Expand one level into the cells of a band. Top-down goes through the current cells of the band and of its
+// neighbours (a band spans more than a row, so no other band can hold a neighbour) and claims the new cells
+// inside the band, bottom-up looks for a frontier neighbour of every unvisited cell of the band. Either way
+// a thread only writes its own words, bands are 64-cell aligned so their 2-bit parents do not share bytes
+static void *expandBand(void *arg) {
+    BfsBand *band = arg;
+    const Map *map = band->map;
+    const int cols = map->cols;
+    size_t count = (size_t) map->rows * cols;
+    size_t low = band->first * 64;
+    size_t high = (band->last * 64 < count) ? band->last * 64 : count;
+
+    band->added = 0;
+    band->found = SIZE_MAX;
+    if (!band->bottomUp) {
+        for (int t = band->id - 1; t <= band->id + 1; t++) {
+            if (t < 0 || t >= band->count) {
+                continue;
+            }
+            const uint32_t *list = band->current + band->bands[t].first * 64;
+            for (size_t k = 0; k < band->bands[t].size; k++) {
+                size_t index = list[k];
+                if (index + cols < low || index >= high + cols) {
+                    continue;
+                }
+                int row = (int) (index / cols) + 1;
+                int col = (int) (index % cols) + 1;
+                for (int side = WALL_L; side <= WALL_V; side <<= 1) {
+                    int step;
+                    size_t next = sideNeighbour(map, index, row, col, side, &step);
+                    if (next >= low && next < high && !(band->visited[next / 64] >> (next % 64) & 1)) {
+                        claimCell(band, next, row + rowDelta[step], col + colDelta[step], step);
+                    }
+                }
+            }
+        }
+    } else {
+        for (size_t w = band->first; w < band->last; w++) {
+            uint64_t open = ~band->visited[w];
+            if (w * 64 + 64 > count) {
+                open &= ((uint64_t) 1 << (count % 64)) - 1;
+            }
+            for (; open != 0; open &= open - 1) {
+                size_t index = w * 64 + (size_t) __builtin_ctzll(open);
+                int row = (int) (index / cols) + 1;
+                int col = (int) (index % cols) + 1;
+                for (int side = WALL_L; side <= WALL_V; side <<= 1) {
+                    int step;
+                    size_t next = sideNeighbour(map, index, row, col, side, &step);
+                    if (next != SIZE_MAX && (band->frontier[next / 64] >> (next % 64) & 1)) {
+                        claimCell(band, index, row, col, 1 + ((step - 1) ^ 1));
+                        break;
+                    }
                 }
+            }
+        }
+    }
+    return NULL;
+}
+
+// searchExit() for huge mazes: small levels go through the serial queue, large ones are split into bands
+// expanded by threadCount threads, top-down or bottom-up (through the frontier bitset) by the size of the
+// level. lists is a second array of a queue's size, the band lists alternate between it and the queue.
+// The exit found may be a different one of the same distance than the serial search picks
+size_t searchParallel(const Map *map, size_t start, int entry, uint64_t *visited, unsigned char *parents,
+                      uint32_t *queue, uint32_t *lists, uint64_t *frontier, size_t *touched) {
+    size_t count = (size_t) map->rows * map->cols;
+    size_t words = (count + 63) / 64;
+    size_t head = 0;
+    size_t tail = 0;
+    size_t seen = 1;
+    size_t widest = count / ((size_t) map->cols + 64);
+    int bands = ((size_t) threadCount < widest) ? threadCount : (int) widest;
+    BfsBand band[MAX_THREADS];
+
+    for (int t = 0; t < bands; t++) {
+        band[t] = (BfsBand) {map, band, t, bands, visited, frontier, parents, lists, queue,
+                             words * t / bands, words * (t + 1) / bands, 0, 0, false, SIZE_MAX};
+    }
+
+    visited[start / 64] |= (uint64_t) 1 << (start % 64);
+    queue[tail++] = (uint32_t) start;
+    while (head < tail) {
+        for (size_t k = head; k < tail; k++) {
+            if (isExitCell(map, queue[k], start, entry)) {
+                *touched = seen;
+                return queue[k];
+            }
+        }
+        if (tail - head < BFS_PARALLEL_FRONTIER || bands < 2) {
+            expandLevel(map, queue, &head, &tail, visited, parents, NULL, false);
+            seen += tail - head;
+            continue;
+        }
+
+        // Hand the level over to the bands that own its cells
+        for (int t = 0; t < bands; t++) {
+            band[t].current = lists;
+            band[t].next = queue;
+            band[t].size = 0;
+        }
+        for (; head < tail; head++) {
+            size_t w = queue[head] / 64;
+            int t = (int) (w * bands / words);
+            while (w < band[t].first) {
+                t--;
+            }
+            while (w >= band[t].last) {
+                t++;
+            }
+            lists[band[t].first * 64 + band[t].size++] = queue[head];
+        }
+
+        for (size_t size = tail; ; ) {
+            bool bottomUp = size * BFS_BOTTOM_UP_RATIO > count - seen;
+            if (bottomUp) {
+                runWorkers(band, sizeof(BfsBand), bands, markBand);
+            }
+            for (int t = 0; t < bands; t++) {
+                band[t].bottomUp = bottomUp;
+            }
+            runWorkers(band, sizeof(BfsBand), bands, expandBand);
+
+            size_t found = SIZE_MAX;
+            size = 0;
+            for (int t = 0; t < bands; t++) {
+                size += band[t].added;
+                found = (band[t].found < found) ? band[t].found : found;
+            }
+            seen += size;
+            if (found != SIZE_MAX || size == 0) {
+                *touched = seen;
+                return found;
+            }
+            for (int t = 0; t < bands; t++) {
+                uint32_t *swap = band[t].current;
+                band[t].current = band[t].next;
+                band[t].next = swap;
+                band[t].size = band[t].added;
+            }
+            if (size < BFS_PARALLEL_FRONTIER / 2) {
+                break;
+            }
+        }
+
+        // Back to the queue, the band lists only move towards its front
+        head = 0;
+        tail = 0;
+        for (int t = 0; t < bands; t++) {
+            memmove(queue + tail, band[t].current + band[t].first * 64, band[t].size * sizeof(uint32_t));
+            tail += band[t].size;
+        }
+    }
+    *touched = seen;
+    return SIZE_MAX;
+}
+
+// Bidirectional search: one BFS from the start, one from every exit cell at once, the smaller frontier is
+// expanded a whole level at a time. The first cell seen by both lies on a shortest route, since no cell
+// within the finished levels of both sides is shared. Returns that cell, SIZE_MAX when there is none
+size_t searchBidi(const Map *map, size_t start, int entry, uint64_t *visited[2], unsigned char *parents[2],
+                  uint32_t *queue[2], size_t *touched) {
+    size_t head[2] = {0, 0};
+    size_t tail[2] = {0, 0};
+    size_t meet = SIZE_MAX;
+
+    visited[0][start / 64] |= (uint64_t) 1 << (start % 64);
+    queue[0][tail[0]++] = (uint32_t) start;
+    if (isExitCell(map, start, start, entry)) {
+        meet = start;
+    }
+
+    // Exit cells are all on the border
+    for (int r = 1; r <= map->rows && meet == SIZE_MAX; r++) {
+        int step = (r == 1 || r == map->rows || map->cols == 1) ? 1 : map->cols - 1;
+        for (int c = 1; c <= map->cols; c += step) {
+            size_t index = (size_t) (r - 1) * map->cols + (c - 1);
+            if (index == start || !isExitCell(map, index, start, entry)) {
+                continue;
+            }
+            visited[1][index / 64] |= (uint64_t) 1 << (index % 64);
+            queue[1][tail[1]++] = (uint32_t) index;
+        }
+    }
+
+    while (meet == SIZE_MAX && head[0] < tail[0] && head[1] < tail[1]) {
+        int side = (tail[0] - head[0] <= tail[1] - head[1]) ? 0 : 1;
+        meet = expandLevel(map, queue[side], &head[side], &tail[side], visited[side], parents[side],
+                           visited[1 - side], side == 1);
+    }
+    *touched = tail[0] + tail[1];
+    return meet;
+}
+
+// Shortest path from r, c to the nearest exit, printed in the selected format
+int solveShortest(int r, int c, const Options *options, const char *fileName) {
+    Map maze;
+    if (loadMap(&maze, fileName)) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
+    if (r < 1 || c < 1 || r > maze.rows || c > maze.cols) {
+        fprintf(stderr, "Cell %d,%d is not in the maze\n", r, c);
+        freeMap(&maze);
+        return 1;
+    }
+
+    size_t count = (size_t) maze.rows * maze.cols;
+    if (count > UINT32_MAX) {
+        fprintf(stderr, "Maze is too large for --shortest\n");
+        freeMap(&maze);
+        return 1;
+    }
+    int sides = options->bidi ? 2 : 1;
+    uint64_t *visited[2] = {NULL, NULL};
+    unsigned char *parents[2] = {NULL, NULL};
+    uint32_t *queue[2] = {NULL, NULL};
+    uint32_t *lists = NULL;
+    uint64_t *frontier = NULL;
+    bool failed = false;
+    for (int side = 0; side < sides; side++) {
+        visited[side] = calloc((count + 63) / 64, sizeof(uint64_t));
+        parents[side] = calloc((count + 3) / 4, 1);
+        queue[side] = malloc(count * sizeof(uint32_t));
+        failed |= (visited[side] == NULL || parents[side] == NULL || queue[side] == NULL);
+    }
+    if (!options->bidi && options->threads > 0) {
+        lists = malloc(count * sizeof(uint32_t));
+        frontier = malloc((count + 63) / 64 * sizeof(uint64_t));
+        failed |= (lists == NULL || frontier == NULL);
+    }
+
+    int result = 0;
+    if (failed) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        result = 1;
+    } else {
+        double begin = now();
+        size_t start = (size_t) (r - 1) * maze.cols + (c - 1);
+        int entry = entrySide(&maze, r, c);
+        size_t touched;
+        size_t meet;
+        if (options->bidi) {
+            meet = searchBidi(&maze, start, entry, visited, parents, queue, &touched);
+        } else if (options->threads > 0) {
+            meet = searchParallel(&maze, start, entry, visited[0], parents[0], queue[0], lists, frontier, &touched);
+        } else {
+            meet = searchExit(&maze, start, entry, visited[0], parents[0], queue[0], &touched);
+        }
+        double elapsed = now() - begin;
+
+        unsigned char *steps = NULL;
+        size_t length = 0;
+        if (meet == SIZE_MAX) {
+            fprintf(stderr, "No exit is reachable from %d,%d\n", r, c);
+            result = 1;
+        } else {
+            length = collectRoute(&maze, parents[0], parents[1], start, meet, entry, &steps);
+            result = (steps == NULL);
+        }
+
+        if (result == 0 && options->format == FORMAT_NONE) {
+            size_t exit = start;
+            for (size_t k = 0; k < length; k++) {
+                exit = stepIndex(&maze, exit, steps[k]);
+            }
+            printf("exit %d,%d steps %zu visited %zu time %.6f s\n", (int) (exit / maze.cols) + 1,
+                   (int) (exit % maze.cols) + 1, length, touched, elapsed);
+        } else if (result == 0) {
+            PathWriter out;
+            result = initWriter(&out, STDOUT_FILENO, options->format);
+            if (result == 0) {
+                writeRoute(&maze, steps, length, start, &out);
+                result = closeWriter(&out);
+            }
+        }
+        free(steps);
+    }
+
+    for (int side = 0; side < sides; side++) {
+        free(visited[side]);
+        free(parents[side]);
+        free(queue[side]);
+    }
+    free(lists);
+    free(frontier);
+    freeMap(&maze);
+    return result;
+}
+
+// Lower bound on the steps between two cells of a maze without walls. Every step flips the shape, a step
+// down leaves a ▲ and a step up leaves a ▼, so |dr| vertical steps need at least |dr| - 1 horizontal steps
+// between them plus one before (start of the wrong shape) and one after (target of the wrong shape)
+static inline long long latticeDistance(int r1, int c1, int r2, int c2) {
+    long long dr = (long long) r2 - r1;
+    long long dc = (c2 > c1) ? (long long) c2 - c1 : (long long) c1 - c2;
+    if (dr == 0) {
+        return dc;
+    }
+    bool startDown = (r1 + c1) % 2 == 0;
+    bool targetDown = (r2 + c2) % 2 == 0;
+    long long horizontal = (dr > 0) ? dr - 1 + startDown + !targetDown : -dr - 1 + !startDown + targetDown;
+    return ((dr > 0) ? dr : -dr) + ((horizontal > dc) ? horizontal : dc);
+}
+
+// Append an entry to an A* bucket, returns 1 when out of memory
+int pushBucket(Bucket *bucket, uint64_t entry) {
+    if (bucket->count == bucket->capacity) {
+        size_t capacity = (bucket->capacity == 0) ? 1024 : bucket->capacity * 2;
+        uint64_t *bigger = realloc(bucket->items, capacity * sizeof(uint64_t));
+        if (bigger == NULL) {
+            fprintf(stderr, "MALLOC_ERR\n");
+            return 1;
+        }
+        bucket->items = bigger;
+        bucket->capacity = capacity;
+    }
+    bucket->items[bucket->count++] = entry;
+    return 0;
+}
+
+// A* from start to target. The heuristic is consistent and a step changes it by exactly one, so the cost
+// of a new entry is the popped cost or two more: the open set is just two buckets, the current cost and the
+// next one, each popped last in first out. A cell is closed the first time it is popped and its parent
+// step comes from that entry. Returns 0 when the target was reached, 1 when not and 2 without memory
+int searchAStar(const Map *map, size_t start, size_t target, uint64_t *closed, unsigned char *parents,
+                size_t *touched) {
+    const int cols = map->cols;
+    int targetRow = (int) (target / cols) + 1;
+    int targetCol = (int) (target % cols) + 1;
+    Bucket buckets[2] = {{NULL, 0, 0}, {NULL, 0, 0}};
+    int current = 0;
+    long long cost = latticeDistance((int) (start / cols) + 1, (int) (start % cols) + 1, targetRow, targetCol);
+    int result = 1;
+
+    *touched = 0;
+    if (pushBucket(&buckets[current], (uint64_t) start * 4)) {
+        return 2;
+    }
+    while (buckets[current].count > 0) {
+        uint64_t entry = buckets[current].items[--buckets[current].count];
+        size_t index = entry / 4;
+        uint64_t mask = (uint64_t) 1 << (index % 64);
+        if (closed[index / 64] & mask) {
+            goto next;
+        }
+        closed[index / 64] |= mask;
+        if (index != start) {
+            parents[index / 4] |= (unsigned char) ((entry % 4) << (2 * (index % 4)));
+        }
+        (*touched)++;
+        if (index == target) {
+            result = 0;
+            break;
+        }
+
+        int row = (int) (index / cols) + 1;
+        int col = (int) (index % cols) + 1;
+        long long distance = cost - latticeDistance(row, col, targetRow, targetCol);
+        for (int w = WALL_L; w <= WALL_V; w <<= 1) {
+            int step;
+            size_t neighbour = sideNeighbour(map, index, row, col, w, &step);
+            if (neighbour == SIZE_MAX || (closed[neighbour / 64] >> (neighbour % 64) & 1)) {
+                continue;
+            }
+            long long nextCost = distance + 1 +
+                                 latticeDistance(row + rowDelta[step], col + colDelta[step], targetRow, targetCol);
+            Bucket *bucket = &buckets[(nextCost == cost) ? current : 1 - current];
+            if (pushBucket(bucket, (uint64_t) neighbour * 4 + (uint64_t) (step - 1))) {
+                result = 2;
+                goto done;
+            }
+        }
+
+    next:
+        if (buckets[current].count == 0) {
+            current = 1 - current;
+            cost += 2;
+        }
+    }
+
+done:
+    free(buckets[0].items);
+    free(buckets[1].items);
+    return result;
+}
+
+// Shortest path between two cells, printed in the selected format
+int solveAStar(int r1, int c1, int r2, int c2, const Options *options, const char *fileName) {
+    Map maze;
+    if (loadMap(&maze, fileName)) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
+    if (r1 < 1 || c1 < 1 || r1 > maze.rows || c1 > maze.cols || r2 < 1 || c2 < 1 || r2 > maze.rows ||
+        c2 > maze.cols) {
+        fprintf(stderr, "Cell is not in the maze\n");
+        freeMap(&maze);
+        return 1;
+    }
 
-            } else if (*step == STEP_INTO_FROM_UP) {
-                if (borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderL == true && borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if (borderL == true && borderR == true && borderUL == false) {
-                    *r -= 1;
-                    *step = STEP_INTO_FROM_DOWN;
-                }
-            }
+    size_t count = (size_t) maze.rows * maze.cols;
+    uint64_t *closed = calloc((count + 63) / 64, sizeof(uint64_t));
+    unsigned char *parents = calloc((count + 3) / 4, 1);
+    if (closed == NULL || parents == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        free(closed);
+        free(parents);
+        freeMap(&maze);
+        return 1;
+    }
+
+    double begin = now();
+    size_t start = (size_t) (r1 - 1) * maze.cols + (c1 - 1);
+    size_t target = (size_t) (r2 - 1) * maze.cols + (c2 - 1);
+    size_t touched;
+    int result = searchAStar(&maze, start, target, closed, parents, &touched);
+    double elapsed = now() - begin;
+
+    unsigned char *steps = NULL;
+    size_t length = 0;
+    if (result == 1) {
+        fprintf(stderr, "No route from %d,%d to %d,%d\n", r1, c1, r2, c2);
+    } else if (result == 0) {
+        length = collectRoute(&maze, parents, NULL, start, target, 0, &steps);
+        result = (steps == NULL);
+    }
+
+    if (result == 0 && options->format == FORMAT_NONE) {
+        printf("target %d,%d steps %zu visited %zu time %.6f s\n", r2, c2, length, touched, elapsed);
+    } else if (result == 0) {
+        PathWriter out;
+        result = initWriter(&out, STDOUT_FILENO, options->format);
+        if (result == 0) {
+            writeRoute(&maze, steps, length, start, &out);
+            result = closeWriter(&out);
         }
-        // leftright = LEFT_HAND
-        else{
-            if (*step == STEP_INTO_FROM_LEFT) {
-                if (borderUL == false) {
-                    *r -= 1;
-                    *step = STEP_INTO_FROM_DOWN;
-                }
-                if (borderUL == true && borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if ((borderUL == true && borderR == true && borderL == false)) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-            } else if (*step == STEP_INTO_FROM_RIGHT) {
-                if (borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderL == true && borderUL == false) {
-                    *r -= 1;
-                    *step = STEP_INTO_FROM_DOWN;
-                }
-                if (borderL == true && borderUL == true && borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
+    }
 
-            } else if (*step == STEP_INTO_FROM_UP) {
-                if (borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if (borderR == true && borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderR == true && borderL == true && borderUL == false) {
-                    *r -= 1;
-                    *step = STEP_INTO_FROM_DOWN;
-                }
-            }
+    free(steps);
+    free(closed);
+    free(parents);
+    freeMap(&maze);
+    return result ? 1 : 0;
+}
+
+// Tell whether any exit can be reached from r, c, using the bit-parallel flood fill
+int solveReachable(int r, int c, const Options *options, const char *fileName) {
+    BitMap maze;
+    if (loadBitMap(&maze, fileName)) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
+    if (r < 1 || c < 1 || r > maze.rows || c > maze.cols) {
+        fprintf(stderr, "Cell %d,%d is not in the maze\n", r, c);
+        freeBitMap(&maze);
+        return 1;
+    }
+
+    size_t words = (size_t) maze.rows * maze.stride;
+    uint64_t *reach = calloc(words, sizeof(uint64_t));
+    if (reach == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        freeBitMap(&maze);
+        return 1;
+    }
+
+    double begin = now();
+    int result = floodFill(&maze, reach, r, c);
+    bool reached = (result == 0) && exitReached(&maze, reach, r, c);
+    double elapsed = now() - begin;
+    if (result == 0 && options->format == FORMAT_NONE) {
+        size_t cells = 0;
+        for (size_t w = 0; w < words; w++) {
+            cells += (size_t) __builtin_popcountll(reach[w]);
         }
+        printf("exit %s cells %zu time %.6f s\n", reached ? "yes" : "no", cells, elapsed);
+    } else if (result == 0) {
+        printf("%s\n", reached ? "Exit reachable" : "No exit reachable");
     }
-    // shape - ▲
-    else if ((*r % 2 != 0 && *c % 2 == 0) || (*r % 2 == 0 && *c % 2 != 0)) {
-        if (leftright == RIGHT_HAND) {
-            if (*step == STEP_INTO_FROM_LEFT) {
-                if (borderUL == false) {
-                    *r += 1;
-                    *step = STEP_INTO_FROM_UP;
-                }
-                if (borderUL == true && borderR == false ) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if ((borderUL == true && borderR == true && borderL == false )) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-            }
-            else if (*step == STEP_INTO_FROM_RIGHT) {
-                if (borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderL == true && borderUL == false) {
-                    *r += 1;
-                    *step = STEP_INTO_FROM_UP;
-                }
-                if (borderL == true && borderUL == true && borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
+
+    free(reach);
+    freeBitMap(&maze);
+    return result;
+}
+
+// Root of the set of cell x, halving the path on the way
+static inline uint32_t findRoot(uint32_t *parents, uint32_t x) {
+    while (parents[x] != x) {
+        parents[x] = parents[parents[x]];
+        x = parents[x];
+    }
+    return x;
+}
+
+// Join the sets of cells a and b, the smaller index becomes the root
+static inline uint32_t joinCells(uint32_t *parents, uint32_t a, uint32_t b) {
+    a = findRoot(parents, a);
+    b = findRoot(parents, b);
+    if (a < b) {
+        parents[b] = a;
+        return a;
+    }
+    parents[a] = b;
+    return b;
+}
+
+// Union-find over the open sides inside one band of rows, ends with every cell pointing at its band root.
+// The sets only grow inside the band, so a thread never touches another band's parents
+static void *labelBand(void *arg) {
+    LabelBand *band = arg;
+    const Map *map = band->map;
+    const int cols = map->cols;
+    uint32_t *parents = band->parents;
+    size_t low = (size_t) band->first * cols;
+    size_t high = (size_t) (band->last + 1) * cols;
+
+    for (size_t index = low; index < high; index++) {
+        parents[index] = (uint32_t) index;
+    }
+    for (int i = band->first; i <= band->last; i++) {
+        for (int j = 0; j < cols; j++) {
+            size_t index = (size_t) i * cols + j;
+            int walls = map->cells[index];
+            if (j + 1 < cols && !(walls & WALL_R)) {
+                joinCells(parents, (uint32_t) index, (uint32_t) (index + 1));
             }
-            else if (*step == STEP_INTO_FROM_DOWN) {
-                if (borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if (borderR == true && borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderR == true && borderL == true && borderUL == false) {
-                    *r += 1;
-                    *step = STEP_INTO_FROM_UP;
-                }
+            // A ▲ cell shares its lower side with the ▼ cell below it
+            if (i < band->last && (i + j) % 2 != 0 && !(walls & WALL_V)) {
+                joinCells(parents, (uint32_t) index, (uint32_t) (index + cols));
             }
         }
-        // leftright = LEFT_HAND
-        else {
-            if (*step == STEP_INTO_FROM_LEFT) {
-                if (borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if (borderR == true && borderUL == false ) {
-                    *r += 1;
-                    *step = STEP_INTO_FROM_UP;
-                }
-                if ((borderR == true && borderUL == true && borderL == false )) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-            }
-            else if (*step == STEP_INTO_FROM_RIGHT) {
-                if (borderUL == false) {
-                    *r += 1;
-                    *step = STEP_INTO_FROM_UP;
-                }
-                if (borderUL == true && borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderUL == true && borderL == true && borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-            }
-            else if (*step == STEP_INTO_FROM_DOWN) {
-                if (borderL == false) {
-                    *c -= 1;
-                    *step = STEP_INTO_FROM_RIGHT;
-                }
-                if (borderL == true && borderR == false) {
-                    *c += 1;
-                    *step = STEP_INTO_FROM_LEFT;
-                }
-                if (borderL == true && borderR == true && borderUL == false) {
-                    *r += 1;
-                    *step = STEP_INTO_FROM_UP;
-                }
+    }
+    for (size_t index = low; index < high; index++) {
+        parents[index] = findRoot(parents, (uint32_t) index);
+    }
+    return NULL;
+}
+
+// Point every cell of a band straight at its final root, only roots changed since labelBand() and final
+// roots are never written here, so the bands can be finished in parallel
+static void *finishBand(void *arg) {
+    LabelBand *band = arg;
+    uint32_t *parents = band->parents;
+    size_t low = (size_t) band->first * band->map->cols;
+    size_t high = (size_t) (band->last + 1) * band->map->cols;
+    for (size_t index = low; index < high; index++) {
+        uint32_t root = parents[index];
+        if (root != index) {
+            parents[index] = parents[root];
+        }
+    }
+    return NULL;
+}
+
+// Label every cell with its open-space component (the lowest cell index in it) and count the open border
+// edges of every component into exits (at the root, saturated at 2). Bands of rows are labeled by threads,
+// their seams are joined serially and the roots that changed are compressed before the final pass
+int labelComponents(const Map *map, uint32_t *parents, unsigned char *exits, int threads) {
+    const int cols = map->cols;
+    int bands = (threads < map->rows) ? threads : map->rows;
+    LabelBand band[MAX_THREADS];
+    for (int t = 0; t < bands; t++) {
+        band[t] = (LabelBand) {map, parents, (int) ((long long) map->rows * t / bands),
+                               (int) ((long long) map->rows * (t + 1) / bands) - 1};
+    }
+    runWorkers(band, sizeof(LabelBand), bands, labelBand);
+
+    uint32_t *joined = malloc(((size_t) cols * 2 * bands + 1) * sizeof(uint32_t));
+    if (joined == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        return 1;
+    }
+    size_t count = 0;
+    for (int t = 0; t + 1 < bands; t++) {
+        int i = band[t].last;
+        for (int j = (i % 2 == 0) ? 1 : 0; j < cols; j += 2) {
+            size_t index = (size_t) i * cols + j;
+            if (!(map->cells[index] & WALL_V)) {
+                // Join through the band roots, the cells themselves have to keep pointing into their band
+                joined[count++] = parents[index];
+                joined[count++] = parents[index + cols];
+                joinCells(parents, joined[count - 2], joined[count - 1]);
             }
         }
     }
+    for (size_t k = 0; k < count; k++) {
+        uint32_t root = findRoot(parents, joined[k]);
+        for (uint32_t x = joined[k]; x != root; ) {
+            uint32_t next = parents[x];
+            parents[x] = root;
+            x = next;
+        }
+    }
+    free(joined);
+    runWorkers(band, sizeof(LabelBand), bands, finishBand);
+
+    memset(exits, 0, (size_t) map->rows * cols);
+    for (int i = 0; i < map->rows; i++) {
+        int step = (i == 0 || i == map->rows - 1 || cols == 1) ? 1 : cols - 1;
+        for (int j = 0; j < cols; j += step) {
+            size_t root = parents[(size_t) i * cols + j];
+            int sides = __builtin_popcount((unsigned) exitSides(map, i + 1, j + 1));
+            exits[root] = (unsigned char) ((exits[root] + sides > 2) ? 2 : exits[root] + sides);
+        }
+    }
     return 0;
 }
 
-// Solving maze according to right-hand rule
-int solveMazeR(int r, int c, const char *fileName) {
-    if (testMap(fileName)) {
-        printf("Definition of maze is INVALID!\n");
-        return 1;
+// Some exit of the component of r, c is not the edge the start is entered through
+bool canEscape(Map *map, const uint32_t *parents, const unsigned char *exits, int r, int c) {
+    int count = exits[parents[(size_t) (r - 1) * map->cols + (c - 1)]];
+    if (exitSides(map, r, c) & entrySide(map, r, c)) {
+        count--;
     }
+    return count > 0;
+}
 
+// Build the component index once and answer "R C" queries read from stdin with "R,C yes|no"
+int solveEscape(const Options *options, const char *fileName) {
     Map maze;
-    readMap(&maze, fileName);
-
-    if ((entryPossible(&maze, r, c)) == false) {
+    if (loadMap(&maze, fileName)) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
+    size_t count = (size_t) maze.rows * maze.cols;
+    if (count > UINT32_MAX) {
+        fprintf(stderr, "Maze is too large for --escape\n");
+        freeMap(&maze);
+        return 1;
+    }
+    uint32_t *parents = malloc(count * sizeof(uint32_t));
+    unsigned char *exits = malloc(count);
+    if (parents == NULL || exits == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        free(parents);
+        free(exits);
         freeMap(&maze);
         return 1;
     }
 
-    int positionR = r;
-    int positionC = c;
-    int* pPosR = &positionR;
-    int* pPosC = &positionC;
-    int historyR = 0;
-    int historyC = 0;
+    double begin = now();
+    int result = labelComponents(&maze, parents, exits, (options->threads > 0) ? threadCount : 1);
+    double elapsed = now() - begin;
+    if (result == 0 && options->format == FORMAT_NONE) {
+        size_t components = 0;
+        for (size_t index = 0; index < count; index++) {
+            components += (parents[index] == index);
+        }
+        printf("components %zu time %.6f s\n", components, elapsed);
+    }
 
-    bool borderL, borderR, borderUL;
+    int r;
+    int c;
+    while (result == 0 && scanf("%d %d", &r, &c) == 2) {
+        if (r < 1 || c < 1 || r > maze.rows || c > maze.cols) {
+            printf("%d,%d outside\n", r, c);
+        } else {
+            printf("%d,%d %s\n", r, c, canEscape(&maze, parents, exits, r, c) ? "yes" : "no");
+        }
+    }
 
-    bool firstStep = true;
-    int step;
-    while (positionR > 0 && positionC > 0 && positionR <= maze.rows && positionC <= maze.cols) {
-        printf("%d,%d\n", positionR, positionC);
+    free(parents);
+    free(exits);
+    freeMap(&maze);
+    return result;
+}
+
+// Position of the outer side w of cell r, c among all outer sides: left sides, right sides, ▼ tops, ▲ bottoms
+static inline int frameIndex(const Map *map, int r, int c, int w) {
+    if (w == WALL_L) {
+        return r - 1;
+    } else if (w == WALL_R) {
+        return map->rows + r - 1;
+    }
+    return 2 * map->rows + (((r + c) % 2 == 0) ? 0 : map->cols) + c - 1;
+}
+
+// Cell and wall side of the outer side at position side, the inverse of frameIndex()
+static inline void frameCell(const Map *map, int side, int *r, int *c, int *w) {
+    if (side < 2 * map->rows) {
+        *r = side % map->rows + 1;
+        *c = (side < map->rows) ? 1 : map->cols;
+        *w = (side < map->rows) ? WALL_L : WALL_R;
+    } else {
+        side -= 2 * map->rows;
+        *r = (side < map->cols) ? 1 : map->rows;
+        *c = side % map->cols + 1;
+        *w = WALL_V;
+    }
+}
 
-        borderL = isborder(&maze, positionR, positionC, LEFT_WALL);
-        borderR = isborder(&maze, positionR, positionC, RIGHT_WALL);
-        borderUL = isborder(&maze, positionR, positionC, UPPERorLOWER_WALL);
+// Print one exit table column: where the walk from R, C with the given hand ends and after how many steps
+static void printExit(const char *hand, int status, int r, int c, unsigned long long steps) {
+    const char *result = (status == WALK_STUCK) ? "stuck" : (status == WALK_CYCLE) ? "cycle" : "exit";
+    printf(" %s %s %d,%d steps %llu", hand, result, r, c, steps);
+}
 
-        move(&maze, &*pPosR, &*pPosC, RIGHT_HAND, borderL, borderR, borderUL, &firstStep, &step);
+// Exit cell and step count of the right- and left-hand walk from every border entrance. The right-hand walks
+// from all open outer sides are disjoint, so walking each of them once costs one pass over the maze, and the
+// left-hand walk entering where a right-hand walk left retraces it backwards, which gives the left column for
+// free. An entrance whose start_border() step does not cross an open outer side is walked on its own
+int solveExitTable(const Options *options, const char *fileName) {
+    Map maze;
+    if (loadMap(&maze, fileName)) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
+    size_t sides = 2 * ((size_t) maze.rows + maze.cols);
+    int *rightExit = malloc(sides * sizeof(int));
+    int *leftExit = malloc(sides * sizeof(int));
+    unsigned long long *lengths = malloc(sides * sizeof(unsigned long long));
+    if (rightExit == NULL || leftExit == NULL || lengths == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        free(rightExit);
+        free(leftExit);
+        free(lengths);
+        freeMap(&maze);
+        return 1;
+    }
 
-        if (((historyR != positionR) || (historyC != positionC)) &&
-        (positionR > 0 && positionC > 0 && positionR <= maze.rows && positionC <= maze.cols)) {
-            historyR = positionR;
-            historyC = positionC;
+    double begin = now();
+    unsigned long long walked = 0;
+    for (int side = 0; side < (int) sides; side++) {
+        int r;
+        int c;
+        int w;
+        frameCell(&maze, side, &r, &c, &w);
+        rightExit[side] = -1;
+        if (!(exitSides(&maze, r, c) & w) || frameIndex(&maze, r, c, w) != side) {
+            continue;
         }
-        else {
-            //We are out of maze
-            freeMap(&maze);
-            return 0;
+        Walk walk;
+        initWalk(&maze, &walk, r, c, RIGHT_HAND);
+        walk.step = 1 + ((sideStep(r, c, w) - 1) ^ 1);
+        walkers[CYCLES_OFF][FORMAT_NONE][RIGHT_HAND](&maze, &walk, NULL);
+        int out = (walk.step == STEP_INTO_FROM_LEFT) ? WALL_R : (walk.step == STEP_INTO_FROM_RIGHT) ? WALL_L : WALL_V;
+        int exit = frameIndex(&maze, walk.row, walk.col, out);
+        rightExit[side] = exit;
+        leftExit[exit] = side;
+        lengths[side] = walk.steps;
+        walked += walk.steps;
+    }
+
+    size_t entrances = 0;
+    for (int r = 1; r <= maze.rows; r++) {
+        // Inner rows only have their first and last cell on the border
+        int skip = (r == 1 || r == maze.rows || maze.cols < 3) ? 1 : maze.cols - 1;
+        for (int c = 1; c <= maze.cols; c += skip) {
+            int step = start_border(&maze, r, c, RIGHT_HAND);
+            if (step < STEP_INTO_FROM_LEFT) {
+                continue;
+            }
+            entrances++;
+            if (options->format == FORMAT_NONE) {
+                continue;
+            }
+            int w = (step == STEP_INTO_FROM_LEFT) ? WALL_L : (step == STEP_INTO_FROM_RIGHT) ? WALL_R : WALL_V;
+            printf("%d,%d", r, c);
+            if ((exitSides(&maze, r, c) & w) && 1 + ((sideStep(r, c, w) - 1) ^ 1) == step) {
+                int side = frameIndex(&maze, r, c, w);
+                int er;
+                int ec;
+                int ew;
+                frameCell(&maze, rightExit[side], &er, &ec, &ew);
+                printExit("right", WALK_EXITED, er, ec, lengths[side]);
+                frameCell(&maze, leftExit[side], &er, &ec, &ew);
+                printExit("left", WALK_EXITED, er, ec, lengths[leftExit[side]]);
+            } else {
+                for (int hand = RIGHT_HAND; hand <= LEFT_HAND; hand++) {
+                    Walk walk;
+                    initWalk(&maze, &walk, r, c, hand);
+                    initCycles(&maze, &walk, CYCLES_BRENT);
+                    walkers[walk.cycles][FORMAT_NONE][hand](&maze, &walk, NULL);
+                    printExit((hand == RIGHT_HAND) ? "right" : "left", walk.status, walk.row, walk.col, walk.steps);
+                    freeWalk(&walk);
+                }
+            }
+            printf("\n");
         }
     }
+    if (options->format == FORMAT_NONE) {
+        printf("entrances %zu steps %llu time %.6f s\n", entrances, walked, now() - begin);
+    }
 
+    free(rightExit);
+    free(leftExit);
+    free(lengths);
     freeMap(&maze);
     return 0;
 }
 
-// Solving maze according to left-hand rule
-int solveMazeL(int r, int c, const char *fileName) {
-    if (testMap(fileName)) {
-        printf("Definition of maze is INVALID!\n");
+// Build the jump tables of the walk with the given hand, and the cycle length behind every state in one pass
+// that follows each state until it meets a cycle or an already labeled state
+int initJumps(const Map *map, JumpIndex *index, int hand) {
+    size_t states = (size_t) map->rows * map->cols * 4;
+    int levels = 1;
+    while (levels < 63 && ((size_t) 1 << levels) <= states) {
+        levels++;
+    }
+    index->states = states;
+    index->levels = levels;
+    index->jumps = NULL;
+    index->cycles = NULL;
+    if (states > UINT32_MAX || (levels + 2) * states * sizeof(uint32_t) > JUMP_TABLE_LIMIT) {
+        fprintf(stderr, "Maze is too large for --where\n");
         return 1;
     }
+    index->jumps = malloc(levels * states * sizeof(uint32_t));
+    index->cycles = calloc(states, sizeof(uint32_t));
+    uint32_t *path = malloc(states * sizeof(uint32_t));
+    if (index->jumps == NULL || index->cycles == NULL || path == NULL) {
+        fprintf(stderr, "MALLOC_ERR\n");
+        free(path);
+        return 1;
+    }
+
+    uint32_t *jumps = index->jumps;
+    for (int row = 1; row <= map->rows; row++) {
+        for (int col = 1; col <= map->cols; col++) {
+            size_t cell = (size_t) (row - 1) * map->cols + (col - 1);
+            int walls = map->cells[cell] & 7;
+            for (int step = STEP_INTO_FROM_LEFT; step <= STEP_INTO_FROM_DOWN; step++) {
+                size_t state = cell * 4 + (size_t) (step - 1);
+                int next = transitions[(row + col) % 2][hand][step - 1][walls];
+                int nextRow = row + rowDelta[next];
+                int nextCol = col + colDelta[next];
+                bool inside = nextRow >= 1 && nextRow <= map->rows && nextCol >= 1 && nextCol <= map->cols;
+                jumps[state] = (uint32_t) ((next != 0 && inside) ? stepIndex(map, cell, next) * 4 + (size_t) (next - 1)
+                                                                  : state);
+            }
+        }
+    }
+    for (int level = 1; level < levels; level++) {
+        const uint32_t *half = jumps + (size_t) (level - 1) * states;
+        uint32_t *full = jumps + (size_t) level * states;
+        for (size_t state = 0; state < states; state++) {
+            full[state] = half[half[state]];
+        }
+    }
+
+    // States on the current path carry UINT32_MAX until the length of the cycle they run into is known
+    uint32_t *cycles = index->cycles;
+    for (size_t first = 0; first < states; first++) {
+        size_t count = 0;
+        uint32_t state = (uint32_t) first;
+        while (cycles[state] == 0) {
+            cycles[state] = UINT32_MAX;
+            path[count++] = state;
+            state = jumps[state];
+        }
+        uint32_t length = cycles[state];
+        if (length == UINT32_MAX) {
+            size_t start = count;
+            while (path[--start] != state) {
+            }
+            length = (uint32_t) (count - start);
+        }
+        while (count > 0) {
+            cycles[path[--count]] = length;
+        }
+    }
+    free(path);
+    return 0;
+}
+
+// Release the jump tables
+int freeJumps(JumpIndex *index) {
+    free(index->jumps);
+    free(index->cycles);
+    index->jumps = NULL;
+    index->cycles = NULL;
+    return 0;
+}
+
+// State k steps after state, k below 2^levels
+static inline uint32_t jumpState(const JumpIndex *index, uint32_t state, unsigned long long k) {
+    for (int level = 0; k != 0; level++, k >>= 1) {
+        if (k & 1) {
+            state = index->jumps[(size_t) level * index->states + state];
+        }
+    }
+    return state;
+}
+
+// State of the walk from state after k steps. tail gets the steps before the walk enters its cycle (or reaches
+// its last state) and length the cycle length, 1 for a walk that ends, so any k takes O(log states) lookups
+uint32_t locateState(const JumpIndex *index, uint32_t state, unsigned long long k, unsigned long long *tail,
+                     uint32_t *length) {
+    uint32_t lambda = index->cycles[state];
+    uint32_t slow = state;
+    uint32_t fast = jumpState(index, state, lambda);
+    unsigned long long mu = 0;
+    for (int level = index->levels - 1; level >= 0; level--) {
+        const uint32_t *jumps = index->jumps + (size_t) level * index->states;
+        if (jumps[slow] != jumps[fast]) {
+            slow = jumps[slow];
+            fast = jumps[fast];
+            mu += 1ULL << level;
+        }
+    }
+    if (slow != fast) {
+        mu++;
+    }
+
+    *tail = mu;
+    *length = lambda;
+    if (k > mu) {
+        k = mu + (k - mu) % lambda;
+    }
+    return jumpState(index, state, k);
+}
+
+// Answer one --where query: the cell after k steps, or where and when the walk ended, and the cycle it runs in
+int printWhere(const Map *map, const JumpIndex *index, int hand, int r, int c, unsigned long long k) {
+    printf("%d,%d %llu", r, c, k);
+    if (r < 1 || c < 1 || r > map->rows || c > map->cols) {
+        printf(" outside\n");
+        return 0;
+    }
+    int step = start_border((Map *) map, r, c, hand);
+    if (step < STEP_INTO_FROM_LEFT || step > STEP_INTO_FROM_DOWN) {
+        printf(" stuck %d,%d steps 0\n", r, c);
+        return 0;
+    }
+
+    unsigned long long tail;
+    uint32_t length;
+    uint32_t start = (uint32_t) (((size_t) (r - 1) * map->cols + (c - 1)) * 4 + (size_t) (step - 1));
+    uint32_t state = locateState(index, start, k, &tail, &length);
+    int row = (int) (state / 4 / map->cols) + 1;
+    int col = (int) (state / 4 % map->cols) + 1;
+    if (length == 1 && k >= tail) {
+        int walls = map->cells[state / 4] & 7;
+        bool stuck = transitions[(row + col) % 2][hand][state % 4][walls] == 0;
+        printf(" %s %d,%d steps %llu\n", stuck ? "stuck" : "exit", row, col, tail);
+        return 0;
+    }
+    printf(" at %d,%d", row, col);
+    if (length > 1) {
+        uint32_t entry = jumpState(index, start, tail);
+        printf(" cycle %d,%d after %llu length %u", (int) (entry / 4 / map->cols) + 1,
+               (int) (entry / 4 % map->cols) + 1, tail, length);
+    }
+    printf("\n");
+    return 0;
+}
 
+// Build the jump index of the --hand walk and answer the query R C K, or "R C K" lines from stdin with queries
+int solveWhere(int r, int c, unsigned long long k, bool queries, const Options *options, const char *fileName) {
     Map maze;
-    readMap(&maze, fileName);
+    if (loadMap(&maze, fileName)) {
+        printf("Definition of maze is INVALID!\n");
+        return 1;
+    }
 
-    if ((entryPossible(&maze, r, c)) == false) {
+    JumpIndex index;
+    double begin = now();
+    if (initJumps(&maze, &index, options->hand)) {
+        freeJumps(&index);
         freeMap(&maze);
         return 1;
     }
+    if (options->format == FORMAT_NONE) {
+        printf("states %zu levels %d time %.6f s\n", index.states, index.levels, now() - begin);
+    }
 
-    int positionR = r;
-    int positionC = c;
-    int* pPosR = &positionR;
-    int* pPosC = &positionC;
-    int historyR = 0;
-    int historyC = 0;
-
-    bool borderL, borderR, borderUL;
+    if (queries) {
+        while (scanf("%d %d %llu", &r, &c, &k) == 3) {
+            printWhere(&maze, &index, options->hand, r, c, k);
+        }
+    } else {
+        printWhere(&maze, &index, options->hand, r, c, k);
+    }
 
-    bool firstStep = true;
-    int step;
-    while (positionR > 0 && positionC > 0 && positionR <= maze.rows && positionC <= maze.cols) {
-        printf("%d,%d\n", positionR, positionC);
+    freeJumps(&index);
+    freeMap(&maze);
+    return 0;
+}
 
-        borderL = isborder(&maze, positionR, positionC, LEFT_WALL);
-        borderR = isborder(&maze, positionR, positionC, RIGHT_WALL);
-        borderUL = isborder(&maze, positionR, positionC, UPPERorLOWER_WALL);
+// Expand a moves or bin path file back to R,C lines
+int decodePath(const char *fileName) {
+    FileView view;
+    if (openView(&view, fileName)) {
+        return 1;
+    }
 
-        move(&maze, &*pPosR, &*pPosC, LEFT_HAND, borderL, borderR, borderUL, &firstStep, &step);
+    const char *data = view.data;
+    const char *end = data + view.size;
+    int row;
+    int col;
+    bool binary = view.size >= PATH_HEADER_SIZE && memcmp(data, PATH_MAGIC, 3) == 0 && data[3] == PATH_VERSION;
+    unsigned long long moves = 0;
+    if (binary) {
+        if (view.size < PATH_HEADER_SIZE + PATH_TRAILER_SIZE) {
+            binary = false;
+        } else {
+            const unsigned char *trailer = (const unsigned char *) end - PATH_TRAILER_SIZE;
+            moves = getU32(trailer) | ((unsigned long long) getU32(trailer + 4) << 32);
+            row = (int) getU32((const unsigned char *) data + 4);
+            col = (int) getU32((const unsigned char *) data + 8);
+            data += PATH_HEADER_SIZE;
+            end -= PATH_TRAILER_SIZE;
+        }
+        if (!binary || (unsigned long long) (end - data) != moves / 4 + (moves % 4 != 0)) {
+            fprintf(stderr, "Invalid path file: %s\n", fileName);
+            closeView(&view);
+            return 1;
+        }
+    } else if (!scanInt(&data, end, &row) || data == end || *data++ != ',' || !scanInt(&data, end, &col)) {
+        fprintf(stderr, "Invalid path file: %s\n", fileName);
+        closeView(&view);
+        return 1;
+    }
 
-        if (((historyR != positionR) || (historyC != positionC)) &&
-            (positionR > 0 && positionC > 0 && positionR <= maze.rows && positionC <= maze.cols)) {
-            historyR = positionR;
-            historyC = positionC;
+    PathWriter out;
+    if (initWriter(&out, STDOUT_FILENO, FORMAT_CELLS)) {
+        closeView(&view);
+        return 1;
+    }
+    writeCell(&out, row, col);
+    if (binary) {
+        for (unsigned long long k = 0; k < moves; k++) {
+            int step = ((unsigned char) data[k / 4] >> (2 * (k % 4)) & 3) + 1;
+            row += rowDelta[step];
+            col += colDelta[step];
+            writeCell(&out, row, col);
         }
-        else {
-            //We are out of maze
-            freeMap(&maze);
-            return 0;
+    } else {
+        for (; data < end; data++) {
+            const char *letter = (*data != '\0' && *data != '?') ? strchr("?LRUD", *data) : NULL;
+            if (letter == NULL) {
+                if (isBlank(*data)) {
+                    continue;
+                }
+                fprintf(stderr, "Invalid path file: %s\n", fileName);
+                closeWriter(&out);
+                closeView(&view);
+                return 1;
+            }
+            int step = (int) (letter - "?LRUD");
+            row += rowDelta[step];
+            col += colDelta[step];
+            writeCell(&out, row, col);
         }
     }
 
-    freeMap(&maze);
+    closeView(&view);
+    return closeWriter(&out);
+}
+
+// Remove the optional switches from argv and store them in options, returns 1 on a bad value
+int parseOptions(int *argc, char *argv[], Options *options) {
+    options->allErrors = false;
+    options->threads = 0;
+    options->format = FORMAT_CELLS;
+    options->cycles = CYCLES_OFF;
+    options->maxSteps = 0;
+    options->deadlineMs = 0;
+    options->bidi = false;
+    options->length = false;
+    options->hand = RIGHT_HAND;
+
+    int kept = 1;
+    for (int k = 1; k < *argc; k++) {
+        if (strcmp(argv[k], "--all-errors") == 0) {
+            options->allErrors = true;
+        } else if (strcmp(argv[k], "--bidi") == 0) {
+            options->bidi = true;
+        } else if (strcmp(argv[k], "--summary") == 0) {
+            options->format = FORMAT_NONE;
+        } else if (strcmp(argv[k], "--length") == 0) {
+            options->length = true;
+        } else if (strncmp(argv[k], "--cycles=", 9) == 0) {
+            const char *name = argv[k] + 9;
+            if (strcmp(name, "auto") == 0) {
+                options->cycles = CYCLES_AUTO;
+            } else if (strcmp(name, "bitset") == 0) {
+                options->cycles = CYCLES_BITSET;
+            } else if (strcmp(name, "brent") == 0) {
+                options->cycles = CYCLES_BRENT;
+            } else if (strcmp(name, "off") == 0) {
+                options->cycles = CYCLES_OFF;
+            } else {
+                return 1;
+            }
+        } else if (strncmp(argv[k], "--hand=", 7) == 0) {
+            const char *name = argv[k] + 7;
+            if (strcmp(name, "right") == 0) {
+                options->hand = RIGHT_HAND;
+            } else if (strcmp(name, "left") == 0) {
+                options->hand = LEFT_HAND;
+            } else {
+                return 1;
+            }
+        } else if (strncmp(argv[k], "--format=", 9) == 0) {
+            const char *name = argv[k] + 9;
+            if (strcmp(name, "cells") == 0) {
+                options->format = FORMAT_CELLS;
+            } else if (strcmp(name, "moves") == 0) {
+                options->format = FORMAT_MOVES;
+            } else if (strcmp(name, "bin") == 0) {
+                options->format = FORMAT_BIN;
+            } else {
+                return 1;
+            }
+        } else if (strcmp(argv[k], "--max-steps") == 0 && k + 1 < *argc) {
+            char *end;
+            options->maxSteps = strtoull(argv[++k], &end, 10);
+            if (*end != '\0' || options->maxSteps == 0 || argv[k][0] == '-') {
+                return 1;
+            }
+        } else if (strcmp(argv[k], "--deadline-ms") == 0 && k + 1 < *argc) {
+            char *end;
+            options->deadlineMs = strtol(argv[++k], &end, 10);
+            if (*end != '\0' || options->deadlineMs <= 0) {
+                return 1;
+            }
+        } else if (strcmp(argv[k], "--threads") == 0 && k + 1 < *argc) {
+            options->threads = atoi(argv[++k]);
+            if (options->threads < 1 || options->threads > MAX_THREADS) {
+                return 1;
+            }
+        } else {
+            argv[kept++] = argv[k];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
     return 0;
 }
 
 int main(int argc, char *argv[]) {
+    Options options;
+    if (parseOptions(&argc, argv, &options)) {
+        printf("Invalid arguments. Use --help for usage information.\n");
+        return 1;
+    }
+
     if (argc < 3) {
         // Not enough arguments, display help
         printHelp();
@@ -590,24 +3728,98 @@ int main(int argc, char *argv[]) {
     }
 
     const char *fileName = argv[argc - 1]; // Last argument is the fileName
+    initKernels();
+#ifdef _SC_NPROCESSORS_ONLN
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threadCount = (cpus < 1) ? 1 : (cpus > MAX_THREADS) ? MAX_THREADS : (int) cpus;
+#endif
+    if (options.threads > 0) {
+        threadCount = options.threads;
+    }
 
     if (strcmp(argv[1], "--help") == 0) {
         printHelp();
     } else if (strcmp(argv[1], "--test") == 0) {
-        if (testMap(fileName)) {
+        ErrorList errors = {NULL, 0, 0};
+        int invalid = (options.threads > 0) ? testMapParallel(fileName, options.allErrors, &errors)
+                                            : testMap(fileName, options.allErrors, &errors);
+        if (invalid) {
             printf("Invalid\n");
+            for (size_t k = 0; k < errors.count; k++) {
+                BorderError *error = &errors.items[k];
+                const char *wall = (error->wall == RIGHT_WALL) ? "right" : (error->wall == BAD_VALUE) ? "value" : "upper";
+                if (options.allErrors) {
+                    printf("%d,%d %s\n", error->row, error->col, wall);
+                } else {
+                    fprintf(stderr, "Borders do not match at %d,%d %s\n", error->row, error->col, wall);
+                }
+            }
         }
         else {
             printf("Valid\n");
         }
+        freeErrors(&errors);
+    } else if (strcmp(argv[1], "--convert") == 0 && argc == 4) {
+        if (convertMap(argv[2], argv[3])) {
+            return 1;
+        }
+    } else if (strcmp(argv[1], "--shortest") == 0 && argc == 5) {
+        int R = atoi(argv[2]);
+        int C = atoi(argv[3]);
+        if (solveShortest(R, C, &options, fileName)) {
+            return 1;
+        }
+    } else if (strcmp(argv[1], "--astar") == 0 && argc == 7) {
+        if (solveAStar(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), &options, fileName)) {
+            return 1;
+        }
+    } else if (strcmp(argv[1], "--reachable") == 0 && argc == 5) {
+        int R = atoi(argv[2]);
+        int C = atoi(argv[3]);
+        if (solveReachable(R, C, &options, fileName)) {
+            return 1;
+        }
+    } else if (strcmp(argv[1], "--escape") == 0 && argc == 3) {
+        if (solveEscape(&options, fileName)) {
+            return 1;
+        }
+    } else if (strcmp(argv[1], "--exit-table") == 0 && argc == 3) {
+        if (solveExitTable(&options, fileName)) {
+            return 1;
+        }
+    } else if (strcmp(argv[1], "--where") == 0 && (argc == 3 || argc == 6)) {
+        unsigned long long K = 0;
+        if (argc == 6) {
+            char *end;
+            K = strtoull(argv[4], &end, 10);
+            if (*end != '\0' || argv[4][0] == '-') {
+                printf("Invalid arguments. Use --help for usage information.\n");
+                return 1;
+            }
+        }
+        int R = (argc == 6) ? atoi(argv[2]) : 0;
+        int C = (argc == 6) ? atoi(argv[3]) : 0;
+        if (solveWhere(R, C, K, argc == 3, &options, fileName)) {
+            return 1;
+        }
+    } else if (strcmp(argv[1], "--decode") == 0) {
+        if (decodePath(fileName)) {
+            return 1;
+        }
     } else if (strcmp(argv[1], "--rpath") == 0 && argc == 5) {
         int R = atoi(argv[2]);
         int C = atoi(argv[3]);
-        solveMazeR(R, C, fileName);
+        int result = solveMazeR(R, C, &options, fileName);
+        if (result == EXIT_CYCLE || result == EXIT_LIMIT) {
+            return result;
+        }
     } else if (strcmp(argv[1], "--lpath") == 0 && argc == 5) {
         int R = atoi(argv[2]);
         int C = atoi(argv[3]);
-        solveMazeL(R, C, fileName);
+        int result = solveMazeL(R, C, &options, fileName);
+        if (result == EXIT_CYCLE || result == EXIT_LIMIT) {
+            return result;
+        }
     } else {
         // Invalid arguments, display help
         printf("Invalid arguments. Use --help for usage information.\n");
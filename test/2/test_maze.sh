@@ -25,8 +25,8 @@ NORMAL='\033[0m'
 test_count=0
 correct=0
 
-# compile maze.c just in case
-gcc -std=c11 -Wall -Wextra -Werror maze.c -o maze
+# compile maze.c of the repository this script lives in (two levels up)
+gcc -std=c11 -Wall -Wextra -Werror -pthread ../../maze.c -o maze
 
 rm -rf diff
 
@@ -39,6 +39,22 @@ run_test() {
     
     actual_output=$(./maze $test_arg $input_file)
     
+    check_output
+}
+
+# like run_test, but runs a whole shell command (pipes, several maze calls)
+run_command_test() {
+    test_command=$1
+    expected_output=$2
+
+    echo -n -e "$test_count. Running ${test_command}\n"
+
+    actual_output=$(eval "$test_command")
+
+    check_output
+}
+
+check_output() {
     if [[ "$actual_output" == "$expected_output" ]]; then
         echo -e "${GREEN} [OK] ${NORMAL}"
         correct=$((correct + 1))
@@ -519,6 +535,226 @@ echo -e "-6 -7\n1 4 4 2 5 0 6\n1 4 4 0 4 0 2\n1 0 4 0 4 6 1\n1 2 7 1 0 4 2\n3 1
 # 23
 run_test "test_11.txt" "--test" "Invalid"
 
+# cell value that wraps around to 0 when stored as a byte
+echo -e "1 2\n256 0" > test_12.txt
+
+# 24
+run_test "test_12.txt" "--test" "Invalid"
+
+# 25
+run_test "test_12.txt" "--test --threads 2" "Invalid"
+
+# shortest path on the assignment maze (same as the bonus test of the course)
+# 26
+run_test "test_01.txt" "--shortest 3 7" "3,7
+2,7
+2,6
+2,5
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+# binary maze converted from the assignment maze and back
+./maze --convert test_01.txt test_01.tmz
+
+# 27
+run_test "test_01.tmz" "--test" "Valid"
+
+# 28
+run_test "test_01.tmz" "--lpath 6 1" "$(./maze --lpath 6 1 test_01.txt)"
+
+# 29
+run_command_test "./maze --convert test_01.tmz test_01_back.txt && cat test_01_back.txt" "$(cat test_01.txt)"
+
+# every bad border of test_02.txt, serial and with threads
+# 30
+run_test "test_02.txt" "--test --all-errors" "Invalid
+3,4 right
+3,5 right
+3,5 upper"
+
+# 31
+run_test "test_02.txt" "--test --all-errors --threads 3" "Invalid
+3,4 right
+3,5 right
+3,5 upper"
+
+# a cell value above 7 ends the list, the bad border at 7,3 below it is never reached
+echo -e "8 7\n4 4 4 4 4 0 6\n1 9 4 4 4 0 6\n1 4 4 4 4 0 6\n1 4 4 4 4 0 6\n1 4 4 4 4 0 6\n1 4 4 4 4 0 6\n1 4 6 4 4 0 6\n5 4 4 4 4 0 6" > test_13.txt
+
+# 32
+run_test "test_13.txt" "--test --all-errors" "Invalid
+2,2 value"
+
+# 33
+run_test "test_13.txt" "--test --all-errors --threads 4" "Invalid
+2,2 value"
+
+# the same binary maze with a broken checksum
+cp test_01.tmz test_12.tmz
+printf '\xff' | dd of=test_12.tmz bs=1 seek=16 conv=notrunc 2>/dev/null
+
+# 34
+run_test "test_01.tmz" "--test --threads 2" "Valid"
+
+# 35
+run_test "test_12.tmz" "--test" "Invalid"
+
+# 36
+run_test "test_12.tmz" "--test --threads 2" "Invalid"
+
+# compact path formats have to decode back to the R,C lines
+# 37
+run_command_test "./maze --format=moves --rpath 6 1 test_01.txt > test_01.moves && ./maze --decode test_01.moves" "$(./maze --rpath 6 1 test_01.txt)"
+
+# 38
+run_command_test "./maze --format=bin --lpath 6 1 test_01.txt > test_01.bin && ./maze --decode test_01.bin" "$(./maze --lpath 6 1 test_01.txt)"
+
+# only the exit and the step count, the time differs from run to run
+# 39
+run_command_test "./maze --summary --rpath 6 1 test_01.txt | cut -d ' ' -f 1-4" "exit 3,7 steps 31"
+
+# 40
+run_command_test "./maze --summary --lpath 6 1 test_01.txt | cut -d ' ' -f 1-4" "exit 1,1 steps 33"
+
+# a walk that leaves the maze is not changed by watching it for cycles
+# 41
+run_command_test "./maze --cycles=bitset --rpath 6 1 test_01.txt" "$(./maze --rpath 6 1 test_01.txt)"
+
+# 42
+run_command_test "./maze --cycles=brent --format=moves --lpath 6 1 test_01.txt" "$(./maze --format=moves --lpath 6 1 test_01.txt)"
+
+# 43
+run_test test_01.txt "--cycles=foo --rpath 6 1" "Invalid arguments. Use --help for usage information."
+
+# a walk cut short by --max-steps or --deadline-ms ends with exit code 3
+# 44
+run_command_test "./maze --max-steps 5 --rpath 6 1 test_01.txt > /dev/null 2>&1; echo \$?" "3"
+
+# 45
+run_command_test "./maze --max-steps 5 --rpath 6 1 test_01.txt 2>&1 >/dev/null" "Step limit reached at 6,4 after 5 steps"
+
+# serpentine 1000x1000 maze, its walk is two million steps long
+awk -v R=1000 -v C=1000 'function gap(i) { return (i % 2 == 0) ? (((i + C - 1) % 2 == 1) ? C - 1 : C - 2) : 0 }
+BEGIN { print R, C
+  for (i = 0; i < R; i++) { line = ""
+    for (j = 0; j < C; j++) { v = 0
+      if (j == 0 && i > 0) v += 1
+      if (j == C - 1) v += 2
+      if ((i + j) % 2 == 1) { if (i == R - 1 || j != gap(i)) v += 4 }
+      else { if (i == 0 || j != gap(i - 1)) v += 4 }
+      line = line (j ? " " : "") v }
+    print line } }' > test_14.txt
+
+# 46
+run_command_test "./maze --deadline-ms 1 --rpath 1 1 test_14.txt > /dev/null 2>&1; echo \$?" "3"
+
+# 47
+run_test "test_01.txt" "--bidi --shortest 3 7" "3,7
+2,7
+2,6
+2,5
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+# 48
+run_test "test_01.txt" "--astar 6 1 1 7" "6,1
+6,2
+5,2
+5,3
+5,4
+6,4
+6,5
+6,6
+5,6
+5,7
+4,7
+4,6
+4,5
+4,4
+3,4
+3,3
+3,2
+3,1
+2,1
+2,2
+2,3
+2,4
+2,5
+2,6
+1,6
+1,7"
+
+# 49
+run_test "test_01.txt" "--threads 2 --shortest 3 7" "3,7
+2,7
+2,6
+2,5
+2,4
+1,4
+1,3
+1,2
+1,1"
+
+# 50
+run_test "test_01.txt" "--reachable 6 1" "Exit reachable"
+
+# 6,7 is walled in, its only open side is the one it is entered through
+# 51
+run_test "test_01.txt" "--reachable 6 7" "No exit reachable"
+
+# 52
+run_command_test "printf '6 1\n3 3\n9 9\n6 7\n' | ./maze --escape test_01.txt" "6,1 yes
+3,3 yes
+9,9 outside
+6,7 no"
+
+# 53
+run_command_test "printf '6 1\n3 3\n9 9\n6 7\n' | ./maze --escape --threads 2 test_01.txt" "6,1 yes
+3,3 yes
+9,9 outside
+6,7 no"
+
+# only how the walk ends, no path
+# 54
+run_test "test_01.txt" "--length --rpath 6 1" "exit 3,7 steps 31"
+
+# 55
+run_test "test_01.txt" "--length --lpath 6 1" "exit 1,1 steps 33"
+
+# 56
+run_test "test_01.txt" "--length --rpath 1 4" "stuck 1,4 steps 0"
+
+# 57
+run_test "test_01.txt" "--exit-table" "1,1 right exit 6,1 steps 33 left exit 3,7 steps 14
+1,4 right stuck 1,4 steps 0 left stuck 1,4 steps 0
+1,6 right stuck 1,6 steps 0 left stuck 1,6 steps 0
+3,7 right exit 1,1 steps 14 left exit 6,1 steps 31
+6,1 right exit 3,7 steps 31 left exit 1,1 steps 33
+6,2 right stuck 6,2 steps 0 left stuck 6,2 steps 0
+6,4 right stuck 6,4 steps 0 left stuck 6,4 steps 0
+6,6 right stuck 6,6 steps 0 left stuck 6,6 steps 0
+6,7 right exit 6,7 steps 0 left exit 6,7 steps 0"
+
+# 58
+run_test "test_01.txt" "--where 6 1 5" "6,1 5 at 6,4"
+
+# 59
+run_test "test_01.txt" "--where 6 1 1000" "6,1 1000 exit 3,7 steps 31"
+
+# 60
+run_test "test_01.txt" "--where 0 1 5" "0,1 5 outside"
+
+# 61
+run_command_test "printf '6 1 5\n6 1 1000\n0 1 5\n' | ./maze --where test_01.txt" "6,1 5 at 6,4
+6,1 1000 exit 3,7 steps 31
+0,1 5 outside"
+
 # print test results
 if [[ "$correct" == "$test_count" ]]; then
     echo -e "\nPassed $correct / $test_count 🎉"
@@ -530,6 +766,14 @@ fi
 # if you want individual tests comment line with the test you want to keep
 # make sure to later uncomment tho :D
 
+rm test_01.tmz
+rm test_01_back.txt
+rm test_13.txt
+rm test_12.tmz
+rm test_01.moves
+rm test_01.bin
+rm test_14.txt
+rm test_12.txt
 rm test_11.txt
 rm test_10.txt
 rm test_09.txt
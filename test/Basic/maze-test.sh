@@ -81,8 +81,8 @@ mkdir ./results
 echo "----- Required functionality -----------------------------------"
 
 # test compilation
-echo "  Compilation: gcc -std=c11 -Wall -Wextra -Werror maze.c -o maze"
-gcc -std=c11 -Wall -Wextra -Werror maze.c -o maze > ./results/compilation_out.txt 2>&1
+echo "  Compilation: gcc -std=c11 -Wall -Wextra -Werror -pthread maze.c -o maze"
+gcc -std=c11 -Wall -Wextra -Werror -pthread maze.c -o maze > ./results/compilation_out.txt 2>&1
 ret=$?
 if [ $ret -ne 0 ]; then
     echo -e "      FAILED (see ./results/compilation_out.txt)\n"